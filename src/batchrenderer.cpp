@@ -0,0 +1,162 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "batchrenderer.h"
+#include "imageloaderinterface.h"
+#include "posterazorcore.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent>
+
+BatchRenderer::BatchRenderer(const ImageLoaderFactory &imageLoaderFactory)
+    : m_imageLoaderFactory(imageLoaderFactory)
+{
+    Q_ASSERT(m_imageLoaderFactory);
+}
+
+void BatchRenderer::setSettings(const QVariantHash &settings)
+{
+    m_settings = settings;
+}
+
+void BatchRenderer::setThreadsCount(int count)
+{
+    m_threadsCount = qMax(0, count);
+}
+
+void BatchRenderer::setMemoryLimit(qint64 bytes)
+{
+    m_memoryLimit = qMax(qint64(0), bytes);
+}
+
+void BatchRenderer::setPageImageFormat(Types::PageImageFormats format, qreal dpi)
+{
+    m_savesPageImages = true;
+    m_pageImageFormat = format;
+    m_pageImageDpi = dpi;
+}
+
+qint64 BatchRenderer::estimatedMemoryUsage(const ImageLoaderInterface *imageLoader, const QString &imageFileName) const
+{
+    // The PDFWriter reads the rows straight from the loader, so that the image
+    // is only held once. Images larger than the memory only keep their tiles.
+    const qint64 bytesCount = imageLoader->residentBytesCount(imageFileName);
+    return bytesCount < 0 ? m_memoryLimit : bytesCount; // Unknown. Better run it alone
+}
+
+BatchRenderer::Result BatchRenderer::renderJob(const Job &job) const
+{
+    Result result;
+
+    QScopedPointer<ImageLoaderInterface> imageLoader(m_imageLoaderFactory());
+    PosteRazorCore posteRazorCore(imageLoader.data());
+    posteRazorCore.setPreviewImageEnabled(false);
+    posteRazorCore.readSettings(m_settings);
+    // The jobs already keep all cores busy
+    if (posteRazorCore.compressionThreadsCount() == 0)
+        posteRazorCore.setCompressionThreadsCount(1);
+
+    if (!posteRazorCore.loadInputImage(job.imageFileName, result.errorMessage)) {
+        if (result.errorMessage.isEmpty())
+            result.errorMessage = QString::fromLatin1("The image '%1' could not be loaded.").arg(job.imageFileName);
+        return result;
+    }
+
+    if (m_savesPageImages) {
+        const int err = posteRazorCore.savePosterPages(job.posterFileName, m_pageImageFormat, m_pageImageDpi);
+        if (err != 0) {
+            result.errorMessage = QString::fromLatin1("The pages of '%1' could not be saved (error %2).").arg(job.posterFileName).arg(err);
+            return result;
+        }
+        result.success = true;
+        return result;
+    }
+
+    QFile posterFile(job.posterFileName);
+    if (!posterFile.open(QIODevice::WriteOnly)) {
+        result.errorMessage = QString::fromLatin1("The file '%1' could not be opened for writing.").arg(job.posterFileName);
+        return result;
+    }
+
+    const int err = posteRazorCore.savePoster(&posterFile);
+    if (err != 0) {
+        posterFile.remove();
+        result.errorMessage = QString::fromLatin1("The file '%1' could not be saved (error %2).").arg(job.posterFileName).arg(err);
+        return result;
+    }
+
+    result.success = true;
+    return result;
+}
+
+QVector<BatchRenderer::Result> BatchRenderer::render(const QVector<Job> &jobs, const ResultHandler &resultHandler) const
+{
+    QVector<Result> results(jobs.count());
+    Result *resultsData = results.data();
+
+    const int threadsCount = m_threadsCount > 0 ? m_threadsCount : QThread::idealThreadCount();
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(threadsCount);
+
+    QMutex mutex;
+    QWaitCondition jobFinished;
+    int runningJobsCount = 0;
+    qint64 reservedBytes = 0;
+
+    const QScopedPointer<ImageLoaderInterface> probingImageLoader(m_imageLoaderFactory());
+
+    for (int jobIndex = 0; jobIndex < jobs.count(); jobIndex++) {
+        // A job which exceeds the limit on its own is started once all others are done
+        const qint64 jobBytes = m_memoryLimit > 0 ?
+            qMin(estimatedMemoryUsage(probingImageLoader.data(), jobs.at(jobIndex).imageFileName), m_memoryLimit) : 0;
+
+        {
+            QMutexLocker locker(&mutex);
+            while (runningJobsCount >= threadsCount
+                   || (runningJobsCount > 0 && m_memoryLimit > 0 && reservedBytes + jobBytes > m_memoryLimit))
+                jobFinished.wait(&mutex);
+            runningJobsCount++;
+            reservedBytes += jobBytes;
+        }
+
+        QtConcurrent::run(&threadPool, [&, jobIndex, jobBytes] {
+            const Result result = renderJob(jobs.at(jobIndex));
+
+            QMutexLocker locker(&mutex);
+            resultsData[jobIndex] = result;
+            runningJobsCount--;
+            reservedBytes -= jobBytes;
+            if (resultHandler)
+                resultHandler(jobIndex, result);
+            jobFinished.wakeAll();
+        });
+    }
+
+    threadPool.waitForDone();
+
+    return results;
+}
@@ -0,0 +1,78 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include "types.h"
+
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include <functional>
+
+class ImageLoaderInterface;
+
+// Renders many posters at once. Each job gets its own image loader and
+// PosteRazorCore on a worker thread. Jobs are only started while their
+// estimated memory usage fits into the memory limit.
+class BatchRenderer
+{
+public:
+    struct Job {
+        QString imageFileName;
+        QString posterFileName;
+    };
+
+    struct Result {
+        bool success = false;
+        QString errorMessage;
+    };
+
+    // Called on the worker threads, so it needs to be thread safe
+    typedef std::function<ImageLoaderInterface*()> ImageLoaderFactory;
+    // Called on the worker threads, but never concurrently
+    typedef std::function<void(int jobIndex, const Result &result)> ResultHandler;
+
+    BatchRenderer(const ImageLoaderFactory &imageLoaderFactory);
+
+    void setSettings(const QVariantHash &settings);
+    void setThreadsCount(int count);
+    void setMemoryLimit(qint64 bytes);
+    // Writes one image per page instead of a PDF. The poster file names are
+    // then the base of the page file names
+    void setPageImageFormat(Types::PageImageFormats format, qreal dpi);
+
+    QVector<Result> render(const QVector<Job> &jobs, const ResultHandler &resultHandler = ResultHandler()) const;
+
+private:
+    qint64 estimatedMemoryUsage(const ImageLoaderInterface *imageLoader, const QString &imageFileName) const;
+    Result renderJob(const Job &job) const;
+
+    ImageLoaderFactory m_imageLoaderFactory;
+    QVariantHash m_settings;
+    int m_threadsCount = 0; // 0 means one thread per core
+    qint64 m_memoryLimit = 0; // 0 means no limit
+    bool m_savesPageImages = false;
+    Types::PageImageFormats m_pageImageFormat = Types::PageImageFormatPng;
+    qreal m_pageImageDpi = 300;
+};
@@ -0,0 +1,548 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "flatestream.h"
+#include "imageloaderqt.h"
+#include "pdfwriter.h"
+#include "posterazorcore.h"
+#if defined (FREEIMAGE_LIB)
+#   include "imageloaderfreeimage.h"
+#endif
+
+#include <QtTest>
+#include <QtGui>
+
+#include <cmath>
+
+#if defined (Q_OS_UNIX)
+#   include <sys/resource.h>
+#endif
+
+// Benchmarks the paths which touch every pixel: loading, preview creation,
+// raw bits, PDF image writing and poster saving. The images are generated
+// on first use. POSTERAZOR_BENCHMARK_MEGAPIXELS restricts the sizes, e.g. "1,25".
+class PosteRazorBenchmarks: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void loadInputImage_data();
+    void loadInputImage();
+    void imageAsRGB_data();
+    void imageAsRGB();
+    void jpegPreview_data();
+    void jpegPreview();
+    void bits_data();
+    void bits();
+    void saveImage_data();
+    void saveImage();
+    void compression_data();
+    void compression();
+    void savePoster_data();
+    void savePoster();
+
+private:
+    static void addImageRows();
+    static ImageLoaderInterface *createImageLoader(const QString &name);
+    static QString generateImage(const QString &fileNameWithoutSuffix, Types::ColorTypes colorType, int megapixels);
+    static bool writeCmykTiff(const QString &fileName, const QSize &size);
+    static void resetPeakMemory();
+    static void reportPeakMemory();
+    QString imageFileName(Types::ColorTypes colorType, int megapixels);
+    QString jpegFileName(int megapixels);
+    QString loadImage(ImageLoaderInterface *imageLoader); // Returns why the row is skipped
+
+    QTemporaryDir m_imagesDir;
+    QHash<QString, QString> m_imageFileNames;
+};
+
+static const struct {
+    Types::ColorTypes colorType;
+    const char *name;
+} colorTypes[] = {
+    {Types::ColorTypeMonochrome,    "Monochrome"},
+    {Types::ColorTypeGreyscale,     "Greyscale"},
+    {Types::ColorTypePalette,       "Palette"},
+    {Types::ColorTypeRGB,           "RGB"},
+    {Types::ColorTypeRGBA,          "RGBA"},
+    {Types::ColorTypeCMYK,          "CMYK"}
+};
+
+static QList<int> megapixelCounts()
+{
+    const QByteArray environment = qgetenv("POSTERAZOR_BENCHMARK_MEGAPIXELS");
+    if (environment.isEmpty())
+        return QList<int>() << 1 << 25 << 200;
+    QList<int> result;
+    foreach (const QByteArray &count, environment.split(','))
+        result.append(count.trimmed().toInt());
+    return result;
+}
+
+void PosteRazorBenchmarks::initTestCase()
+{
+    QVERIFY(m_imagesDir.isValid());
+}
+
+void PosteRazorBenchmarks::addImageRows()
+{
+    QTest::addColumn<QString>("loader");
+    QTest::addColumn<int>("colorType");
+    QTest::addColumn<int>("megapixels");
+
+    QStringList loaders = QStringList() << QLatin1String("Qt");
+#if defined (FREEIMAGE_LIB)
+    loaders << QLatin1String("FreeImage");
+#endif
+    foreach (const QString &loader, loaders)
+        for (const auto &colorType : colorTypes)
+            foreach (int megapixels, megapixelCounts())
+                QTest::newRow(QString::fromLatin1("%1 %2 %3MP").arg(loader).arg(QLatin1String(colorType.name)).arg(megapixels).toLatin1())
+                    << loader << int(colorType.colorType) << megapixels;
+}
+
+ImageLoaderInterface *PosteRazorBenchmarks::createImageLoader(const QString &name)
+{
+#if defined (FREEIMAGE_LIB)
+    if (name == QLatin1String("FreeImage"))
+        return new ImageLoaderFreeImage;
+#else
+    Q_UNUSED(name)
+#endif
+    return new ImageLoaderQt;
+}
+
+// A gradient with some structure, so that compressing it is neither trivial nor hopeless
+static inline uchar patternByte(int x, int y, int channel)
+{
+    return uchar(((x + channel * 37) ^ (y * 3)) + (x >> 4) + (y >> 5));
+}
+
+bool PosteRazorBenchmarks::writeCmykTiff(const QString &fileName, const QSize &size)
+{
+    // Qt cannot write CMYK images. This is the minimal baseline TIFF for them.
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    const quint32 width = quint32(size.width());
+    const quint32 height = quint32(size.height());
+    const quint16 entriesCount = 11;
+    const quint32 ifdOffset = 8;
+    const quint32 bitsPerSampleOffset = ifdOffset + 2 + entriesCount * 12 + 4;
+    const quint32 stripOffset = bitsPerSampleOffset + 4 * 2;
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData("II", 2);
+    stream << quint16(42) << ifdOffset << entriesCount;
+    const auto entry = [&stream] (quint16 tag, quint16 type, quint32 count, quint32 value) {
+        stream << tag << type << count;
+        if (type == 3 && count == 1)
+            stream << quint16(value) << quint16(0); // SHORT values are left aligned
+        else
+            stream << value;
+    };
+    entry(256, 4, 1, width);                // ImageWidth
+    entry(257, 4, 1, height);               // ImageLength
+    entry(258, 3, 4, bitsPerSampleOffset);  // BitsPerSample
+    entry(259, 3, 1, 1);                    // Compression: none
+    entry(262, 3, 1, 5);                    // PhotometricInterpretation: separated
+    entry(273, 4, 1, stripOffset);          // StripOffsets
+    entry(277, 3, 1, 4);                    // SamplesPerPixel
+    entry(278, 4, 1, height);               // RowsPerStrip
+    entry(279, 4, 1, width * height * 4);   // StripByteCounts
+    entry(284, 3, 1, 1);                    // PlanarConfiguration: chunky
+    entry(332, 3, 1, 1);                    // InkSet: CMYK
+    stream << quint32(0);
+    stream << quint16(8) << quint16(8) << quint16(8) << quint16(8);
+
+    QByteArray scanline(int(width) * 4, 0);
+    for (int y = 0; y < int(height); y++) {
+        uchar *pixel = reinterpret_cast<uchar*>(scanline.data());
+        for (int x = 0; x < int(width); x++)
+            for (int channel = 0; channel < 4; channel++)
+                *pixel++ = patternByte(x, y, channel);
+        if (file.write(scanline) != scanline.size())
+            return false;
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+QString PosteRazorBenchmarks::generateImage(const QString &fileNameWithoutSuffix, Types::ColorTypes colorType, int megapixels)
+{
+    // 4:3, like most photos
+    const int width = qRound(std::sqrt(megapixels * 1000000.0 * 4 / 3));
+    const QSize size(width, megapixels * 1000000 / width);
+
+    if (colorType == Types::ColorTypeCMYK) {
+        const QString fileName = fileNameWithoutSuffix + QLatin1String(".tif");
+        return writeCmykTiff(fileName, size) ? fileName : QString();
+    }
+
+    const QImage::Format format =
+        colorType == Types::ColorTypeMonochrome ? QImage::Format_Mono
+        : colorType == Types::ColorTypeGreyscale || colorType == Types::ColorTypePalette ? QImage::Format_Indexed8
+        : colorType == Types::ColorTypeRGBA ? QImage::Format_ARGB32
+        : QImage::Format_RGB32;
+    QImage image(size, format);
+    if (image.isNull())
+        return QString();
+
+    if (colorType == Types::ColorTypeGreyscale) {
+        QVector<QRgb> colorTable;
+        for (int index = 0; index < 256; index++)
+            colorTable.append(qRgb(index, index, index));
+        image.setColorTable(colorTable);
+    } else if (colorType == Types::ColorTypePalette) {
+        QVector<QRgb> colorTable;
+        for (int index = 0; index < 256; index++)
+            colorTable.append(qRgb(index, 255 - index, (index * 7) & 0xff));
+        image.setColorTable(colorTable);
+    }
+
+    const int bytesPerLine = (image.width() * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); y++) {
+        uchar *line = image.scanLine(y);
+        for (int byte = 0; byte < bytesPerLine; byte++)
+            line[byte] = patternByte(byte, y, 0);
+        if (colorType == Types::ColorTypeRGBA)
+            for (int x = 0; x < image.width(); x++)
+                line[x * 4 + 3] = uchar(x * 255 / image.width()); // Alpha, as QImage expects it
+    }
+
+    // BMP is quick to write and read. Only PNG keeps the alpha channel.
+    const QString fileName = fileNameWithoutSuffix
+        + (colorType == Types::ColorTypeRGBA ? QLatin1String(".png") : QLatin1String(".bmp"));
+    return image.save(fileName) ? fileName : QString();
+}
+
+QString PosteRazorBenchmarks::imageFileName(Types::ColorTypes colorType, int megapixels)
+{
+    const QString key = QString::fromLatin1("%1-%2").arg(int(colorType)).arg(megapixels);
+    if (!m_imageFileNames.contains(key))
+        m_imageFileNames.insert(key, generateImage(m_imagesDir.filePath(key), colorType, megapixels));
+    return m_imageFileNames.value(key);
+}
+
+QString PosteRazorBenchmarks::jpegFileName(int megapixels)
+{
+    const QString key = QString::fromLatin1("jpeg-%1").arg(megapixels);
+    if (!m_imageFileNames.contains(key)) {
+        const QString fileName = m_imagesDir.filePath(key + QLatin1String(".jpg"));
+        const QImage image(imageFileName(Types::ColorTypeRGB, megapixels));
+        m_imageFileNames.insert(key, !image.isNull() && image.save(fileName, "JPEG", 90) ? fileName : QString());
+    }
+    return m_imageFileNames.value(key);
+}
+
+void PosteRazorBenchmarks::resetPeakMemory()
+{
+#if defined (Q_OS_LINUX)
+    // Resets VmHWM
+    QFile clearRefs(QLatin1String("/proc/self/clear_refs"));
+    if (clearRefs.open(QIODevice::WriteOnly))
+        clearRefs.write("5");
+#endif
+}
+
+void PosteRazorBenchmarks::reportPeakMemory()
+{
+#if defined (Q_OS_LINUX)
+    QFile status(QLatin1String("/proc/self/status"));
+    if (status.open(QIODevice::ReadOnly))
+        foreach (const QByteArray &line, status.readAll().split('\n'))
+            if (line.startsWith("VmHWM:"))
+                qInfo("Peak RSS: %s", line.mid(6).simplified().constData());
+#elif defined (Q_OS_UNIX)
+    // Not resettable. The peak of the whole run so far
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        qInfo("Peak RSS of the process: %ld kB", long(usage.ru_maxrss / 1024));
+#endif
+}
+
+QString PosteRazorBenchmarks::loadImage(ImageLoaderInterface *imageLoader)
+{
+    QFETCH(QString, loader);
+    QFETCH(int, colorType);
+    QFETCH(int, megapixels);
+
+    const QString fileName = imageFileName(Types::ColorTypes(colorType), megapixels);
+    if (fileName.isEmpty())
+        return QLatin1String("The image could not be generated");
+    QString errorMessage;
+    if (!imageLoader->loadInputImage(fileName, errorMessage))
+        return QString::fromLatin1("%1 cannot load %2: %3").arg(loader, fileName, errorMessage);
+    return QString();
+}
+
+void PosteRazorBenchmarks::loadInputImage_data()
+{
+    addImageRows();
+}
+
+void PosteRazorBenchmarks::loadInputImage()
+{
+    QFETCH(QString, loader);
+    QFETCH(int, colorType);
+    QFETCH(int, megapixels);
+
+    const QString fileName = imageFileName(Types::ColorTypes(colorType), megapixels);
+    if (fileName.isEmpty())
+        QSKIP("The image could not be generated");
+
+    resetPeakMemory();
+    QBENCHMARK {
+        QScopedPointer<ImageLoaderInterface> imageLoader(createImageLoader(loader));
+        QString errorMessage;
+        if (!imageLoader->loadInputImage(fileName, errorMessage))
+            QSKIP(qPrintable(errorMessage));
+    }
+    reportPeakMemory();
+}
+
+void PosteRazorBenchmarks::imageAsRGB_data()
+{
+    addImageRows();
+}
+
+void PosteRazorBenchmarks::imageAsRGB()
+{
+    QFETCH(QString, loader);
+    QScopedPointer<ImageLoaderInterface> imageLoader(createImageLoader(loader));
+    const QString skipReason = loadImage(imageLoader.data());
+    if (!skipReason.isEmpty())
+        QSKIP(qPrintable(skipReason));
+
+    // What PosteRazorCore::createPreviewImage() asks for
+    const QSize previewSize = imageLoader->sizePixels().scaled(1024, 768, Qt::KeepAspectRatio);
+    resetPeakMemory();
+    QBENCHMARK {
+        const QImage preview = imageLoader->imageAsRGB(previewSize);
+        QVERIFY(!preview.isNull());
+    }
+    reportPeakMemory();
+}
+
+void PosteRazorBenchmarks::jpegPreview_data()
+{
+    QTest::addColumn<QString>("loader");
+    QTest::addColumn<int>("megapixels");
+    QTest::addColumn<bool>("scaledDecode");
+
+    QStringList loaders = QStringList() << QLatin1String("Qt");
+#if defined (FREEIMAGE_LIB)
+    loaders << QLatin1String("FreeImage");
+#endif
+    foreach (const QString &loader, loaders)
+        foreach (int megapixels, megapixelCounts())
+            for (bool scaledDecode : {false, true})
+                QTest::newRow(QString::fromLatin1("%1 %2MP %3").arg(loader).arg(megapixels)
+                              .arg(QLatin1String(scaledDecode ? "scaled decode" : "full decode")).toLatin1())
+                    << loader << megapixels << scaledDecode;
+}
+
+void PosteRazorBenchmarks::jpegPreview()
+{
+    QFETCH(QString, loader);
+    QFETCH(int, megapixels);
+    QFETCH(bool, scaledDecode);
+
+    const QString fileName = jpegFileName(megapixels);
+    if (fileName.isEmpty())
+        QSKIP("The JPEG could not be generated");
+
+    // The time until the first preview, from the file
+    resetPeakMemory();
+    QBENCHMARK {
+        QScopedPointer<ImageLoaderInterface> imageLoader(createImageLoader(loader));
+        QImage preview;
+        if (scaledDecode) {
+            preview = imageLoader->readPreviewImage(fileName, QSize(1024, 768));
+        } else {
+            QString errorMessage;
+            if (!imageLoader->loadInputImage(fileName, errorMessage))
+                QSKIP(qPrintable(errorMessage));
+            preview = imageLoader->imageAsRGB(imageLoader->sizePixels().scaled(1024, 768, Qt::KeepAspectRatio));
+        }
+        QVERIFY(!preview.isNull());
+    }
+    reportPeakMemory();
+}
+
+void PosteRazorBenchmarks::bits_data()
+{
+    addImageRows();
+}
+
+void PosteRazorBenchmarks::bits()
+{
+    QFETCH(QString, loader);
+    QScopedPointer<ImageLoaderInterface> imageLoader(createImageLoader(loader));
+    const QString skipReason = loadImage(imageLoader.data());
+    if (!skipReason.isEmpty())
+        QSKIP(qPrintable(skipReason));
+
+    resetPeakMemory();
+    QBENCHMARK {
+        const QByteArray bits = imageLoader->bits();
+        QVERIFY(!bits.isEmpty());
+    }
+    reportPeakMemory();
+}
+
+void PosteRazorBenchmarks::saveImage_data()
+{
+    addImageRows();
+}
+
+void PosteRazorBenchmarks::saveImage()
+{
+    QFETCH(QString, loader);
+    QScopedPointer<ImageLoaderInterface> imageLoader(createImageLoader(loader));
+    const QString skipReason = loadImage(imageLoader.data());
+    if (!skipReason.isEmpty())
+        QSKIP(qPrintable(skipReason));
+    const ImageLoaderInterface *reader = imageLoader.data();
+    const QString pdfFileName = m_imagesDir.filePath(QLatin1String("saveImage.pdf"));
+
+    resetPeakMemory();
+    QBENCHMARK {
+        QFile pdfFile(pdfFileName);
+        QVERIFY(pdfFile.open(QIODevice::WriteOnly));
+        PDFWriter pdfWriter;
+        pdfWriter.setCompressionThreadsCount(QThread::idealThreadCount());
+        QCOMPARE(pdfWriter.startSaving(&pdfFile, 1, 21.0, 29.7), 0);
+        const int err = pdfWriter.saveImage([reader] (int firstRow, int rowsCount, char *destination) {
+                reader->readScanlines(firstRow, rowsCount, destination);
+            }, reader->sizePixels(), reader->bitsPerPixel(), reader->colorDataType(), reader->colorTable());
+        QCOMPARE(err, 0);
+    }
+    reportPeakMemory();
+}
+
+void PosteRazorBenchmarks::compression_data()
+{
+    QTest::addColumn<int>("colorType");
+    QTest::addColumn<int>("pngPredictor");
+    QTest::addColumn<int>("compressionLevel");
+    QTest::addColumn<int>("deflateBackend");
+
+    static const struct {
+        Types::PngPredictors predictor;
+        const char *name;
+    } predictors[] = {
+        {Types::PngPredictorNone,       "None"},
+        {Types::PngPredictorSub,        "Sub"},
+        {Types::PngPredictorUp,         "Up"},
+        {Types::PngPredictorPaeth,      "Paeth"},
+        {Types::PngPredictorAdaptive,   "Adaptive"}
+    };
+    static const struct {
+        Types::DeflateBackends backend;
+        const char *name;
+    } backends[] = {
+        {Types::DeflateBackendZlib,         "zlib"},
+        {Types::DeflateBackendZlibNg,       "zlib-ng"},
+        {Types::DeflateBackendLibDeflate,   "libdeflate"}
+    };
+    for (const auto &colorType : colorTypes) {
+        if (colorType.colorType != Types::ColorTypeGreyscale && colorType.colorType != Types::ColorTypeRGB)
+            continue;
+        for (const auto &backend : backends) {
+            if (!FlateStream::isBackendAvailable(backend.backend))
+                continue;
+            for (const auto &predictor : predictors)
+                for (int level : {1, 6, 9})
+                    QTest::newRow(QString::fromLatin1("%1 %2 %3 level %4").arg(QLatin1String(colorType.name))
+                                  .arg(QLatin1String(backend.name)).arg(QLatin1String(predictor.name)).arg(level).toLatin1())
+                        << int(colorType.colorType) << int(predictor.predictor) << level << int(backend.backend);
+        }
+    }
+}
+
+// The PDF size and save time of deflate backend, predictor and compression level combinations.
+// Uses the smallest image size.
+void PosteRazorBenchmarks::compression()
+{
+    QFETCH(int, colorType);
+    QFETCH(int, pngPredictor);
+    QFETCH(int, compressionLevel);
+    QFETCH(int, deflateBackend);
+
+    const QString fileName = imageFileName(Types::ColorTypes(colorType), megapixelCounts().first());
+    if (fileName.isEmpty())
+        QSKIP("The image could not be generated");
+    ImageLoaderQt imageLoader;
+    QString errorMessage;
+    if (!imageLoader.loadInputImage(fileName, errorMessage))
+        QSKIP(qPrintable(errorMessage));
+    const ImageLoaderInterface *reader = &imageLoader;
+    const QString pdfFileName = m_imagesDir.filePath(QLatin1String("compression.pdf"));
+
+    QBENCHMARK {
+        QFile pdfFile(pdfFileName);
+        QVERIFY(pdfFile.open(QIODevice::WriteOnly));
+        PDFWriter pdfWriter;
+        pdfWriter.setCompressionLevel(compressionLevel);
+        pdfWriter.setPngPredictor(Types::PngPredictors(pngPredictor));
+        pdfWriter.setDeflateBackend(Types::DeflateBackends(deflateBackend));
+        QCOMPARE(pdfWriter.startSaving(&pdfFile, 1, 21.0, 29.7), 0);
+        const int err = pdfWriter.saveImage([reader] (int firstRow, int rowsCount, char *destination) {
+                reader->readScanlines(firstRow, rowsCount, destination);
+            }, reader->sizePixels(), reader->bitsPerPixel(), reader->colorDataType(), reader->colorTable());
+        QCOMPARE(err, 0);
+    }
+    qInfo("PDF size: %lld bytes", QFileInfo(pdfFileName).size());
+}
+
+void PosteRazorBenchmarks::savePoster_data()
+{
+    addImageRows();
+}
+
+void PosteRazorBenchmarks::savePoster()
+{
+    QFETCH(QString, loader);
+    QScopedPointer<ImageLoaderInterface> imageLoader(createImageLoader(loader));
+    const QString skipReason = loadImage(imageLoader.data());
+    if (!skipReason.isEmpty())
+        QSKIP(qPrintable(skipReason));
+    PosteRazorCore posteRazorCore(imageLoader.data());
+    posteRazorCore.setPreviewImageEnabled(false);
+    posteRazorCore.setPosterSizeMode(Types::PosterSizeModePages);
+    posteRazorCore.setPosterWidth(Types::PosterSizeModePages, 3.0);
+    const QString pdfFileName = m_imagesDir.filePath(QLatin1String("savePoster.pdf"));
+
+    resetPeakMemory();
+    QBENCHMARK {
+        QFile pdfFile(pdfFileName);
+        QVERIFY(pdfFile.open(QIODevice::WriteOnly));
+        QCOMPARE(posteRazorCore.savePoster(&pdfFile), 0);
+    }
+    reportPeakMemory();
+}
+
+QTEST_GUILESS_MAIN(PosteRazorBenchmarks)
+#include "bench_posterazor.moc"
@@ -0,0 +1,34 @@
+QT += testlib widgets printsupport
+
+TARGET = bench_posterazor
+
+# Uncomment the following line in order to also benchmark ImageLoaderFreeImage
+#DEFINES += FREEIMAGE_LIB
+
+SOURCES += \
+    bench_posterazor.cpp
+
+contains (DEFINES, FREEIMAGE_LIB) {
+    # posterazor.pri leaves out ImageLoaderQt in FreeImage builds, but both are benchmarked
+    SOURCES += \
+        imageloaderfreeimage.cpp \
+        imageloaderqt.cpp
+
+    HEADERS += \
+        imageloaderfreeimage.h \
+        imageloaderqt.h
+
+    win32:INCLUDEPATH += \
+        thirdparty/FreeImage/Dist
+
+    win32:LIBS += \
+        thirdparty/FreeImage/Dist/FreeImage.lib
+
+    macx: INCLUDEPATH += \
+        /usr/local/include
+
+    unix:LIBS += \
+        -lfreeimage
+}
+
+include (posterazor.pri)
@@ -0,0 +1,198 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "commandline.h"
+#include "posterazorcore.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QSettings>
+#include <QTextStream>
+
+const QLatin1String option_Batch(          "batch");
+const QLatin1String option_Settings(       "settings");
+const QLatin1String option_OutputDirectory("output-directory");
+const QLatin1String option_Suffix(         "suffix");
+const QLatin1String option_Jobs(           "jobs");
+const QLatin1String option_MemoryLimit(    "memory-limit");
+const QLatin1String option_PageImages(     "page-images");
+const QLatin1String option_Dpi(            "dpi");
+
+const QLatin1String defaultValue_Suffix(   "-poster.pdf");
+const QLatin1String defaultValue_PageImagesSuffix("-poster");
+const QLatin1String defaultValue_Dpi(      "300");
+
+// "PaperBorderTop" -> "paper-border-top"
+static QString optionName(const QString &settingsKey)
+{
+    QString name;
+    for (const QChar character : settingsKey) {
+        if (character.isUpper() && !name.isEmpty())
+            name.append(QLatin1Char('-'));
+        name.append(character.toLower());
+    }
+    return name;
+}
+
+bool CommandLine::isBatchModeRequested(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+        if (qstrcmp(argv[i], "--batch") == 0)
+            return true;
+    return false;
+}
+
+int CommandLine::exec(const BatchRenderer::ImageLoaderFactory &imageLoaderFactory)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String(
+        "Renders posters without user interface. The settings default to those "
+        "of a fresh PosteRazor installation. A settings file is read first, "
+        "options given on the command line override it. Values are given like "
+        "in the settings file of PosteRazor."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QLatin1String("images"), QLatin1String("Images to render into posters."),
+                                 QLatin1String("images..."));
+    parser.addOption(QCommandLineOption(option_Batch, QLatin1String("Runs without user interface.")));
+    const QCommandLineOption settingsOption(option_Settings,
+        QLatin1String("Reads the settings from the INI <file>."), QLatin1String("file"));
+    parser.addOption(settingsOption);
+    const QCommandLineOption outputDirectoryOption(QStringList() << QLatin1String("o") << option_OutputDirectory,
+        QLatin1String("Writes the posters into <directory>. Default is the directory of each image."),
+        QLatin1String("directory"));
+    parser.addOption(outputDirectoryOption);
+    const QCommandLineOption suffixOption(option_Suffix,
+        QString::fromLatin1("Forms the poster file names from image base names and <suffix>. Default is \"%1\".")
+            .arg(defaultValue_Suffix),
+        QLatin1String("suffix"), defaultValue_Suffix);
+    parser.addOption(suffixOption);
+    const QCommandLineOption jobsOption(QStringList() << QLatin1String("j") << option_Jobs,
+        QLatin1String("Renders up to <count> posters at once. Default is one per core."),
+        QLatin1String("count"), QLatin1String("0"));
+    parser.addOption(jobsOption);
+    const QCommandLineOption memoryLimitOption(option_MemoryLimit,
+        QLatin1String("Starts no further posters while the images being rendered would take more than <megabytes>."),
+        QLatin1String("megabytes"), QLatin1String("0"));
+    parser.addOption(memoryLimitOption);
+    const QCommandLineOption pageImagesOption(option_PageImages,
+        QString::fromLatin1("Writes one image per page instead of a PDF. <format> is png or tiff. The page numbers "
+                            "are appended to the poster file names. The suffix then defaults to \"%1\".")
+            .arg(defaultValue_PageImagesSuffix),
+        QLatin1String("format"));
+    parser.addOption(pageImagesOption);
+    const QCommandLineOption dpiOption(option_Dpi,
+        QString::fromLatin1("Renders the page images at <dpi>. Default is %1.").arg(defaultValue_Dpi),
+        QLatin1String("dpi"), defaultValue_Dpi);
+    parser.addOption(dpiOption);
+    const QStringList settingsKeys = PosteRazorCore::settingsKeys();
+    for (const QString &key : settingsKeys)
+        parser.addOption(QCommandLineOption(optionName(key), QString::fromLatin1("Sets %1.").arg(key), QLatin1String("value")));
+    parser.process(*QCoreApplication::instance());
+
+    const QStringList imageFileNames = parser.positionalArguments();
+    if (imageFileNames.isEmpty()) {
+        err << "No images given." << '\n';
+        return 1;
+    }
+
+    // Options given on the command line override those from the settings file
+    QVariantHash settings;
+    if (parser.isSet(settingsOption)) {
+        const QString settingsFileName = parser.value(settingsOption);
+        if (!QFileInfo(settingsFileName).isFile()) {
+            err << QString::fromLatin1("The settings file '%1' does not exist.").arg(settingsFileName) << '\n';
+            return 1;
+        }
+        const QSettings settingsFile(settingsFileName, QSettings::IniFormat);
+        for (const QString &key : settingsKeys)
+            if (settingsFile.contains(key))
+                settings.insert(key, settingsFile.value(key));
+    }
+    for (const QString &key : settingsKeys) {
+        const QString name = optionName(key);
+        if (parser.isSet(name))
+            settings.insert(key, parser.value(name));
+    }
+    QString settingsError;
+    if (!PosteRazorCore::checkSettings(settings, settingsError)) {
+        err << settingsError << '\n';
+        return 1;
+    }
+
+    const bool hasOutputDirectory = parser.isSet(outputDirectoryOption);
+    const QDir outputDirectory(parser.value(outputDirectoryOption));
+    if (hasOutputDirectory && !outputDirectory.exists()) {
+        err << QString::fromLatin1("The output directory '%1' does not exist.").arg(outputDirectory.path()) << '\n';
+        return 1;
+    }
+    const bool savesPageImages = parser.isSet(pageImagesOption);
+    const QString pageImageFormat = parser.value(pageImagesOption).toLower();
+    if (savesPageImages && pageImageFormat != QLatin1String("png") && pageImageFormat != QLatin1String("tiff")) {
+        err << QString::fromLatin1("The page image format '%1' is neither png nor tiff.").arg(pageImageFormat) << '\n';
+        return 1;
+    }
+    bool dpiIsValid = false;
+    const qreal dpi = parser.value(dpiOption).toDouble(&dpiIsValid);
+    if (savesPageImages && (!dpiIsValid || dpi <= 0)) {
+        err << QString::fromLatin1("The resolution '%1' is invalid.").arg(parser.value(dpiOption)) << '\n';
+        return 1;
+    }
+    const QString suffix = savesPageImages && !parser.isSet(suffixOption) ?
+        QString(defaultValue_PageImagesSuffix) : parser.value(suffixOption);
+
+    QVector<BatchRenderer::Job> jobs;
+    for (const QString &imageFileName : imageFileNames) {
+        const QFileInfo imageFileInfo(imageFileName);
+        const QString posterFileName = (hasOutputDirectory ? outputDirectory : imageFileInfo.absoluteDir())
+            .filePath(imageFileInfo.completeBaseName() + suffix);
+        jobs.append({imageFileName, posterFileName});
+    }
+
+    BatchRenderer batchRenderer(imageLoaderFactory);
+    batchRenderer.setSettings(settings);
+    batchRenderer.setThreadsCount(parser.value(jobsOption).toInt());
+    batchRenderer.setMemoryLimit(parser.value(memoryLimitOption).toLongLong() * 1024 * 1024);
+    if (savesPageImages)
+        batchRenderer.setPageImageFormat(pageImageFormat == QLatin1String("tiff") ?
+            Types::PageImageFormatTiff : Types::PageImageFormatPng, dpi);
+
+    int failedCount = 0;
+    batchRenderer.render(jobs, [&] (int jobIndex, const BatchRenderer::Result &result) {
+        const BatchRenderer::Job &job = jobs.at(jobIndex);
+        if (result.success) {
+            out << job.posterFileName << '\n';
+            out.flush();
+        } else {
+            err << QString::fromLatin1("%1: %2").arg(job.imageFileName, result.errorMessage) << '\n';
+            err.flush();
+            failedCount++;
+        }
+    });
+
+    return failedCount == 0 ? 0 : 1;
+}
@@ -21,6 +21,7 @@
 */
 
 #include "controller.h"
+#include "imageloaderinterface.h"
 #include "posterazorcore.h"
 #include "wizardcontroller.h"
 
@@ -28,12 +29,18 @@
 #include <QCoreApplication>
 #include <QDesktopServices>
 #include <QFileDialog>
+#include <QFutureWatcher>
+#include <QImage>
 #include <QLocale>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QTranslator>
 #include <QUrl>
+#include <QtConcurrent>
+
+#include <array>
 
 #ifdef Q_OS_WASM
 #include <emscripten.h>
@@ -46,11 +53,21 @@ const QLatin1String settingsKey_TranslationName("TranslationName");
 const QLatin1String settingsKey_ImageLoadPath("ImageLoadPath");
 const QLatin1String settingsKey_PosterSavePath("PosterSavePath");
 
+struct LoadedInputImage
+{
+    bool successful = false;
+    QString errorMessage;
+    QImage previewImage;
+};
+
 Controller::Controller(PosteRazorCore *posteRazorCore, QWidget *view, QObject *parent)
     : QObject(parent)
     , m_posteRazorCore(posteRazorCore)
     , m_view(view)
 {
+    // posterSavingProgress() is queued from the saving thread
+    qRegisterMetaType<Types::SavingStages>("Types::SavingStages");
+
     connect(m_view, SIGNAL(paperFormatChanged(const QString&)), SLOT(setPaperFormat(const QString&)));
     connect(m_view, SIGNAL(paperOrientationChanged(QPageLayout::Orientation)), SLOT(setPaperOrientation(QPageLayout::Orientation)));
     connect(m_view, SIGNAL(paperBorderTopChanged(qreal)), SLOT(setPaperBorderTop(qreal)));
@@ -72,7 +89,7 @@ Controller::Controller(PosteRazorCore *posteRazorCore, QWidget *view, QObject *p
     connect(m_view, SIGNAL(savePosterSignal()), SLOT(savePoster()));
     connect(m_view, SIGNAL(launchPDFApplicationChanged(bool)), SLOT(setLaunchPDFApplication(bool)));
     connect(m_view, SIGNAL(loadImageSignal()), SLOT(loadInputImage()));
-    connect(m_view, SIGNAL(loadImageSignal(const QString&)), SLOT(loadInputImage(const QString&)));
+    connect(m_view, SIGNAL(loadImageSignal(const QString&)), SLOT(startLoadingInputImage(const QString&)));
     connect(m_view, SIGNAL(translationChanged(const QString&)), SLOT(loadTranslation(const QString&)));
     connect(m_view, SIGNAL(unitOfLengthChanged(const QString&)), SLOT(setUnitOfLength(const QString&)));
     connect(m_view, SIGNAL(openPosteRazorWebsiteSignal()), SLOT(openPosteRazorWebsite()));
@@ -456,7 +473,7 @@ void Controller::loadInputImage()
                                          loadPathSettings.value(settingsKey_ImageLoadPath, loadPathDefault).toString(),
                                          allFilters.join(QLatin1String(";;")));
 
-    handleInputImageSelected(loadFileName);
+    startLoadingInputImage(loadFileName);
 #endif // QT_OS_WASM
 }
 
@@ -481,22 +498,93 @@ bool Controller::loadInputImage(const QString &imageFileName, QString &errorMess
     return result;
 }
 
-int Controller::savePoster(const QString &fileName) const
+void Controller::startLoadingInputImage(const QString &fileName)
 {
+    if (fileName.isEmpty())
+        return;
+
 #ifdef Q_OS_WASM
+    // No threads
+    handleInputImageSelected(fileName);
+    return;
+#endif // Q_OS_WASM
+
+    // A newly selected image replaces one which is still loading
+    if (m_loadingCanceled)
+        *m_loadingCanceled = true;
+    const std::shared_ptr<std::atomic<bool> > canceled = std::make_shared<std::atomic<bool> >(false);
+    m_loadingCanceled = canceled;
+
+    emit showImageFileNameSignal(fileName);
+    emit setPosterSavingEnabledSignal(false);
+
+    // Both loaders are new, so that the current image stays usable until the new one is loaded
+    const PosteRazorCore *posteRazorCore = m_posteRazorCore;
+    ImageLoaderInterface *imageLoader = m_posteRazorCore->createImageLoader();
+    ImageLoaderInterface *previewImageLoader = m_posteRazorCore->createImageLoader();
+
+    // The quick preview is shown while the whole image is still decoding
+    QFutureWatcher<QImage> *previewWatcher = new QFutureWatcher<QImage>(this);
+    connect(previewWatcher, &QFutureWatcher<QImage>::finished, this, [=] {
+        const QImage previewImage = previewWatcher->result();
+        previewWatcher->deleteLater();
+        if (m_loadingCanceled == canceled && !previewImage.isNull())
+            m_posteRazorCore->setLoadingPreviewImage(previewImage);
+    });
+    previewWatcher->setFuture(QtConcurrent::run([posteRazorCore, previewImageLoader, fileName] {
+        const QScopedPointer<ImageLoaderInterface> imageLoader(previewImageLoader);
+        return posteRazorCore->readPreviewImage(imageLoader.data(), fileName);
+    }));
+
+    QFutureWatcher<LoadedInputImage> *watcher = new QFutureWatcher<LoadedInputImage>(this);
+    connect(watcher, &QFutureWatcher<LoadedInputImage>::finished, this, [=] {
+        const LoadedInputImage loadedImage = watcher->result();
+        watcher->deleteLater();
+        if (m_loadingCanceled != canceled) {
+            delete imageLoader;
+            return;
+        }
+        m_loadingCanceled.reset();
+
+        if (loadedImage.successful) {
+            m_posteRazorCore->setInputImage(imageLoader, loadedImage.previewImage);
+            updateDialog();
+            emit setPosterSavingEnabledSignal(true);
+            QSettings loadPathSettings;
+            loadPathSettings.setValue(settingsKey_ImageLoadPath,
+                QDir::toNativeSeparators(QFileInfo(fileName).absolutePath()));
+        } else {
+            delete imageLoader;
+            m_posteRazorCore->setLoadingPreviewImage(QImage());
+            emit showImageFileNameSignal(m_posteRazorCore->fileName());
+            emit setPosterSavingEnabledSignal(m_posteRazorCore->isImageLoaded());
+            QMessageBox::critical(m_view, QString(), QCoreApplication::translate("Main window", "The image '%1' could not be loaded.")
+                .arg(QFileInfo(fileName).fileName()));
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([posteRazorCore, imageLoader, fileName, canceled] {
+        LoadedInputImage result;
+        result.successful = posteRazorCore->loadInputImage(imageLoader, fileName, result.errorMessage,
+                                                           result.previewImage, *canceled);
+        return result;
+    }));
+}
+
+void Controller::savePoster(const QString &fileName)
+{
+#ifdef Q_OS_WASM
+    // No threads, the page would not be responsive during saving anyway
     QByteArray posterData;
     QBuffer outIODevice(&posterData);
     outIODevice.open(QIODevice::WriteOnly);
-#else
-    QFile outIODevice(fileName);
-    if (!outIODevice.open((QIODevice::WriteOnly)))
-        return -1;
-#endif // Q_OS_WASM
 
     const int result = m_posteRazorCore->savePoster(&outIODevice);
-
-#ifdef Q_OS_WASM
     outIODevice.close();
+    if (result != 0) {
+        handlePosterSaved(fileName, result);
+        return;
+    }
+
     // Snippet borrowed from my dear colleague Morten:
     // https://codereview.qt-project.org/c/qt/qtbase/+/228599
     EM_ASM_({
@@ -518,14 +606,98 @@ int Controller::savePoster(const QString &fileName) const
         document.body.removeChild(link);
     }, posterData.constData(), posterData.length(), fileName.toUtf8().constData());
 #else
-    if (result == 0 && m_launchPDFApplication)
-        QDesktopServices::openUrl(QUrl::fromLocalFile(fileName));
+    QFile *outFile = new QFile(fileName);
+    if (!outFile->open(QIODevice::WriteOnly)) {
+        delete outFile;
+        handlePosterSaved(fileName, -1);
+        return;
+    }
+
+    // The window modal dialog keeps the settings from being changed while the
+    // saving thread reads them
+    QProgressDialog *progressDialog = new QProgressDialog(m_view);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setWindowTitle(QCoreApplication::translate("Main window", "Save the poster"));
+    progressDialog->setLabelText(QCoreApplication::translate("Main window", "Saving '%1'").arg(QFileInfo(fileName).fileName()));
+    progressDialog->setAutoClose(false);
+    progressDialog->setAutoReset(false);
+    progressDialog->setRange(0, 0);
+    progressDialog->open();
+    emit setPosterSavingEnabledSignal(false);
+
+    const std::shared_ptr<std::atomic<bool> > canceled = std::make_shared<std::atomic<bool> >(false);
+    connect(progressDialog, &QProgressDialog::canceled, [canceled] {
+        *canceled = true;
+    });
+
+    // Image rows and compressed bytes advance together, so the bar follows the
+    // compression, and then the pages.
+    connect(this, &Controller::posterSavingProgress, progressDialog,
+            [progressDialog] (Types::SavingStages stage, qint64 done, qint64 total) {
+        if (stage == Types::SavingStageImage || progressDialog->wasCanceled())
+            return;
+        progressDialog->setLabelText(stage == Types::SavingStagePages ?
+            QCoreApplication::translate("Main window", "Writing page %1 of %2").arg(done).arg(total)
+            : QCoreApplication::translate("Main window", "Compressing the image"));
+        progressDialog->setRange(0, total > 0 ? 1000 : 0);
+        progressDialog->setValue(total > 0 ? int(qMin(done, total) * 1000 / total) : 0);
+    });
+
+    // The writer reports every row. Only signal once a stage advanced by a permille.
+    const std::shared_ptr<std::array<int, 3> > lastPermilles = std::make_shared<std::array<int, 3> >();
+    lastPermilles->fill(-1);
+    const Controller *controller = this;
+    const Types::SavingProgressHandler progressHandler =
+            [controller, canceled, lastPermilles] (Types::SavingStages stage, qint64 done, qint64 total) {
+        const int permille = total > 0 ? int(qMin(done, total) * 1000 / total) : 0;
+        if (permille != lastPermilles->at(stage)) {
+            (*lastPermilles)[stage] = permille;
+            emit controller->posterSavingProgress(stage, done, total);
+        }
+        return !*canceled;
+    };
+
+    const PosteRazorCore *posteRazorCore = m_posteRazorCore;
+    QFutureWatcher<int> *watcher = new QFutureWatcher<int>(this);
+    connect(watcher, &QFutureWatcher<int>::finished, this, [=] {
+        const int result = watcher->result();
+        outFile->close();
+        delete outFile;
+        // Also a cancelled poster leaves no partial file behind
+        if (result != 0)
+            QFile::remove(fileName);
+        watcher->deleteLater();
+        progressDialog->deleteLater();
+        emit setPosterSavingEnabledSignal(!m_loadingCanceled);
+        handlePosterSaved(fileName, result);
+    });
+    watcher->setFuture(QtConcurrent::run([posteRazorCore, outFile, progressHandler] {
+        return posteRazorCore->savePoster(outFile, progressHandler);
+    }));
 #endif // Q_OS_WASM
+}
 
-    return result;
+void Controller::handlePosterSaved(const QString &fileName, int result)
+{
+    if (result == Types::savingCanceledError)
+        return;
+
+    if (result != 0) {
+        QMessageBox::critical(m_view, QString(), QCoreApplication::translate("Main window", "The file '%1' could not be saved.").arg(QFileInfo(fileName).fileName()), QMessageBox::Ok, QMessageBox::NoButton);
+        return;
+    }
+
+#ifndef Q_OS_WASM
+    QSettings savePathSettings;
+    savePathSettings.setValue(settingsKey_PosterSavePath,
+        QDir::toNativeSeparators(QFileInfo(fileName).absolutePath()));
+
+    if (m_launchPDFApplication)
+        QDesktopServices::openUrl(QUrl::fromLocalFile(fileName));
+#endif // Q_OS_WASM
 }
 
-void Controller::savePoster() const
+void Controller::savePoster()
 {
 #ifdef Q_OS_WASM
     savePoster(QFileInfo(m_posteRazorCore->fileName()).baseName() + QLatin1String(".pdf"));
@@ -563,12 +735,8 @@ void Controller::savePoster() const
             if (!fileExistsAskUserForOverwrite
                     || QMessageBox::Yes == (QMessageBox::question(m_view, QString(), QCoreApplication::translate("Main window", "The file '%1' already exists.\nDo you want to overwrite it?").arg(saveFileInfo.fileName()), QMessageBox::Yes, QMessageBox::No))
                 ) {
-                int result = savePoster(saveFileName);
-                if (result != 0)
-                    QMessageBox::critical(m_view, QString(), QCoreApplication::translate("Main window", "The file '%1' could not be saved.").arg(saveFileInfo.fileName()), QMessageBox::Ok, QMessageBox::NoButton);
-                else
-                    savePathSettings.setValue(settingsKey_PosterSavePath,
-                        QDir::toNativeSeparators(QFileInfo(saveFileName).absolutePath()));
+                // Reports the result in handlePosterSaved(), once the poster is written
+                savePoster(saveFileName);
                 fileExistsAskUserForOverwrite = false;
             }
         } else {
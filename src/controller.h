@@ -25,6 +25,9 @@
 #include "types.h"
 #include <QObject>
 
+#include <atomic>
+#include <memory>
+
 QT_BEGIN_NAMESPACE
 class QAction;
 class QSettings;
@@ -71,8 +74,9 @@ public slots:
     void loadInputImage();
     bool loadInputImage(const QString &fileName);
     bool loadInputImage(const QString &fileName, QString &errorMessage);
-    int savePoster(const QString &fileName) const;
-    void savePoster() const;
+    void startLoadingInputImage(const QString &fileName);
+    void savePoster(const QString &fileName);
+    void savePoster();
     void loadTranslation(const QString &localeName);
     void setUnitOfLength(const QString &unit);
     void openPosteRazorWebsite();
@@ -85,6 +89,8 @@ signals:
     void imageInfoChanged(int imageWidthInPixels, int imageHeightInPixels, qreal imageWidth,
         qreal imageHeight, Types::UnitsOfLength unitOfLength, qreal verticalDpi, qreal horizontalDpi,
         Types::ColorTypes colorType, int bitsPerPixel) const;
+    // Emitted from the saving thread
+    void posterSavingProgress(Types::SavingStages stage, qint64 done, qint64 total) const;
 
     /* Privately used signals */
     void setPaperFormatSignal(const QString &format);
@@ -128,6 +134,7 @@ protected:
     WizardController *m_wizardController = nullptr;
     QTranslator *m_translator = nullptr;
     QString m_translationName;
+    std::shared_ptr<std::atomic<bool> > m_loadingCanceled; // Of the image which is currently loading
 
     void setDialogSaveOptions();
     void setDialogPosterSizeMode();
@@ -140,4 +147,5 @@ protected:
     void setDialogOverlappingDimensions();
     void setDialogOverlappingOptions();
     bool handleInputImageSelected(const QString &fileName);
+    void handlePosterSaved(const QString &fileName, int result);
 };
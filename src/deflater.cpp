@@ -0,0 +1,86 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "deflater.h"
+
+#include <zlib.h>
+
+class ZlibDeflater: public Deflater
+{
+public:
+    ~ZlibDeflater() override
+    {
+        if (m_initialized)
+            deflateEnd(&m_stream);
+    }
+
+    bool init(int compressionLevel, int windowBits) override
+    {
+        m_stream.zalloc = Z_NULL;
+        m_stream.zfree = Z_NULL;
+        m_stream.opaque = Z_NULL;
+        m_initialized = deflateInit2(&m_stream, compressionLevel, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        return m_initialized;
+    }
+
+    bool setDictionary(const char *dictionary, int size) override
+    {
+        return deflateSetDictionary(&m_stream, reinterpret_cast<const Bytef*>(dictionary), uInt(size)) == Z_OK;
+    }
+
+    qint64 bound(qint64 size) override
+    {
+        return qint64(deflateBound(&m_stream, uLong(size)));
+    }
+
+    int deflate(const char *&input, uint &inputSize, char *&output, uint &outputSize, int flush) override
+    {
+        m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+        m_stream.avail_in = inputSize;
+        m_stream.next_out = reinterpret_cast<Bytef*>(output);
+        m_stream.avail_out = outputSize;
+        const int result = ::deflate(&m_stream, flush);
+        input = reinterpret_cast<const char*>(m_stream.next_in);
+        inputSize = m_stream.avail_in;
+        output = reinterpret_cast<char*>(m_stream.next_out);
+        outputSize = m_stream.avail_out;
+        return result;
+    }
+
+private:
+    z_stream m_stream;
+    bool m_initialized = false;
+};
+
+Deflater *Deflater::create(Types::DeflateBackends backend)
+{
+    switch (backend) {
+    case Types::DeflateBackendZlib:
+        return new ZlibDeflater;
+#ifdef ZLIBNG_LIB
+    case Types::DeflateBackendZlibNg:
+        return createZlibNgDeflater();
+#endif
+    default:
+        return nullptr;
+    }
+}
@@ -0,0 +1,50 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include "types.h"
+
+#include <QtGlobal>
+
+// One deflate stream of zlib or of the native API of zlib-ng. Their headers
+// cannot be included into the same file, so each backend implements this.
+// Results and flush modes are those of zlib.
+class Deflater
+{
+public:
+    virtual ~Deflater() = default;
+
+    // Returns nullptr for the backends which do not stream or are not built in
+    static Deflater *create(Types::DeflateBackends backend);
+
+    // windowBits as for deflateInit2(): 15 for the zlib format, -15 for raw deflate data
+    virtual bool init(int compressionLevel, int windowBits) = 0;
+    virtual bool setDictionary(const char *dictionary, int size) = 0;
+    virtual qint64 bound(qint64 size) = 0;
+    // Like deflate(), advances input and output by what it consumed and produced
+    virtual int deflate(const char *&input, uint &inputSize, char *&output, uint &outputSize, int flush) = 0;
+};
+
+#ifdef ZLIBNG_LIB
+Deflater *createZlibNgDeflater();
+#endif
@@ -0,0 +1,320 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "deflater.h"
+#include "flatestream.h"
+
+#include <QIODevice>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <zlib.h>
+#ifdef LIBDEFLATE_LIB
+#   include <libdeflate.h>
+#endif
+
+const int outputBufferSize = 256 * 1024;
+const qint64 maximalInputChunkSize = 64 * 1024 * 1024; // z_stream::avail_in is an uInt
+const int parallelChunkSize = 512 * 1024;
+const int deflateWindowSize = 32 * 1024;
+const int wholeBufferMaximalSize = 16 * 1024 * 1024; // Enough for the largest image tiles
+
+// The backend which takes over streams that are too large for libdeflate
+static Types::DeflateBackends streamingBackend()
+{
+    return FlateStream::isBackendAvailable(Types::DeflateBackendZlibNg) ? Types::DeflateBackendZlibNg
+                                                                        : Types::DeflateBackendZlib;
+}
+
+FlateStream::FlateStream(QIODevice *outputDevice, int compressionLevel, QThreadPool *threadPool, Types::DeflateBackends backend)
+    : m_outputDevice(outputDevice)
+    , m_compressionLevel(qBound(0, compressionLevel, 9))
+    , m_threadPool(threadPool && threadPool->maxThreadCount() > 1 ? threadPool : nullptr)
+    , m_backend(isBackendAvailable(backend) ? backend : Types::DeflateBackendZlib)
+{
+    if (m_backend != Types::DeflateBackendLibDeflate)
+        startStreaming();
+}
+
+FlateStream::~FlateStream()
+{
+    // Unfinished chunks only reference their own data, but the pool outlives us
+    for (QFuture<CompressedChunk> &pendingChunk : m_pendingChunks)
+        pendingChunk.waitForFinished();
+}
+
+bool FlateStream::isBackendAvailable(Types::DeflateBackends backend)
+{
+    switch (backend) {
+    case Types::DeflateBackendZlib:
+        return true;
+#ifdef ZLIBNG_LIB
+    case Types::DeflateBackendZlibNg:
+        return true;
+#endif
+#ifdef LIBDEFLATE_LIB
+    case Types::DeflateBackendLibDeflate:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+void FlateStream::startStreaming()
+{
+    m_streaming = true;
+    if (m_backend == Types::DeflateBackendLibDeflate)
+        m_backend = streamingBackend();
+
+    if (m_threadPool) {
+        m_chunk.reserve(parallelChunkSize);
+
+        // zlib header, see RFC 1950
+        const int compressionMethodAndFlags = 0x78; // Deflate, 32K window
+        const int compressionLevelFlag =
+            m_compressionLevel < 2 ? 0
+            : m_compressionLevel < 6 ? 1
+            : m_compressionLevel == 6 ? 2
+            : 3;
+        int flags = compressionLevelFlag << 6;
+        flags += 31 - (compressionMethodAndFlags * 256 + flags) % 31;
+        const char header[] = {char(compressionMethodAndFlags), char(flags)};
+        writeToDevice(header, sizeof header);
+    } else {
+        m_outputBuffer.resize(outputBufferSize);
+        m_stream.reset(Deflater::create(m_backend));
+        if (!m_stream || !m_stream->init(m_compressionLevel, 15)) {
+            m_stream.reset();
+            m_failed = true;
+        }
+    }
+}
+
+bool FlateStream::write(const char *data, qint64 length)
+{
+    if (m_failed || m_finished)
+        return false;
+
+    if (!m_streaming) {
+        if (m_wholeBuffer.size() + length <= wholeBufferMaximalSize) {
+            m_wholeBuffer.append(data, int(length));
+            return true;
+        }
+        if (!continueAsStream())
+            return false;
+    }
+
+    return writeStreaming(data, length);
+}
+
+// Passes what the libdeflate backend has collected so far to a streaming backend
+bool FlateStream::continueAsStream()
+{
+    startStreaming();
+    const QByteArray wholeBuffer = m_wholeBuffer;
+    m_wholeBuffer.clear();
+    return !m_failed && writeStreaming(wholeBuffer.constData(), wholeBuffer.size());
+}
+
+bool FlateStream::writeStreaming(const char *data, qint64 length)
+{
+    if (!m_stream) {
+        while (length > 0 && !m_failed) {
+            const int bytesToAppend = int(qMin(length, qint64(parallelChunkSize - m_chunk.size())));
+            m_chunk.append(data, bytesToAppend);
+            data += bytesToAppend;
+            length -= bytesToAppend;
+            if (m_chunk.size() == parallelChunkSize)
+                enqueueChunk(false);
+        }
+        return !m_failed;
+    }
+
+    while (length > 0) {
+        const qint64 chunkSize = qMin(length, maximalInputChunkSize);
+        if (!deflateData(data, chunkSize, Z_NO_FLUSH))
+            return false;
+        data += chunkSize;
+        length -= chunkSize;
+    }
+    return true;
+}
+
+bool FlateStream::finish()
+{
+    if (m_finished)
+        return !m_failed;
+
+    if (!m_streaming) {
+        if (deflateWholeBuffer()) {
+            m_finished = true;
+            return !m_failed;
+        }
+        if (!continueAsStream())
+            return false;
+    }
+
+    if (!m_stream) {
+        if (m_failed)
+            return false;
+        enqueueChunk(true);
+        while (!m_pendingChunks.isEmpty() && !m_failed)
+            writeChunk(m_pendingChunks.dequeue().result());
+        const char trailer[] = {
+            char(m_adler32 >> 24), char(m_adler32 >> 16), char(m_adler32 >> 8), char(m_adler32)
+        };
+        writeToDevice(trailer, sizeof trailer);
+        m_finished = true;
+        return !m_failed;
+    }
+
+    m_finished = deflateData(nullptr, 0, Z_FINISH);
+    return m_finished;
+}
+
+qint64 FlateStream::bytesWritten() const
+{
+    return m_bytesWritten;
+}
+
+bool FlateStream::deflateData(const char *data, qint64 length, int flush)
+{
+    if (!m_stream || m_finished)
+        return false;
+
+    uint inputSize = uint(length);
+    int result = Z_OK;
+    uint outputSize = 0;
+    do {
+        char *output = m_outputBuffer.data();
+        outputSize = uint(m_outputBuffer.size());
+        result = m_stream->deflate(data, inputSize, output, outputSize, flush);
+        if (result == Z_STREAM_ERROR)
+            return false;
+        if (!writeToDevice(m_outputBuffer.constData(), m_outputBuffer.size() - outputSize))
+            return false;
+    } while (outputSize == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+
+    return true;
+}
+
+// Returns false if libdeflate cannot compress the buffer. Failing to write sets m_failed.
+bool FlateStream::deflateWholeBuffer()
+{
+#ifdef LIBDEFLATE_LIB
+    // Older libdeflate versions have no level 0
+    libdeflate_compressor *compressor = libdeflate_alloc_compressor(m_compressionLevel);
+    if (!compressor)
+        return false;
+    QByteArray compressed(int(libdeflate_zlib_compress_bound(compressor, size_t(m_wholeBuffer.size()))), 0);
+    const size_t compressedSize = libdeflate_zlib_compress(compressor, m_wholeBuffer.constData(), size_t(m_wholeBuffer.size()),
+                                                           compressed.data(), size_t(compressed.size()));
+    libdeflate_free_compressor(compressor);
+    if (compressedSize == 0)
+        return false;
+    m_wholeBuffer.clear();
+    writeToDevice(compressed.constData(), qint64(compressedSize));
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FlateStream::writeToDevice(const char *data, qint64 length)
+{
+    if (m_outputDevice->write(data, length) != length)
+        m_failed = true;
+    else
+        m_bytesWritten += length;
+    return !m_failed;
+}
+
+void FlateStream::enqueueChunk(bool isLastChunk)
+{
+    const QByteArray chunk = m_chunk;
+    const QByteArray previousChunk = m_previousChunk;
+    const int compressionLevel = m_compressionLevel;
+    const Types::DeflateBackends backend = m_backend;
+    m_pendingChunks.enqueue(QtConcurrent::run(m_threadPool, [=] () {
+        return deflateChunk(backend, chunk, previousChunk, compressionLevel, isLastChunk);
+    }));
+    m_previousChunk = m_chunk;
+    m_chunk = QByteArray();
+    m_chunk.reserve(parallelChunkSize);
+
+    // Keep the number of chunks in memory bounded
+    const int maximalPendingChunksCount = m_threadPool->maxThreadCount() * 2;
+    while (m_pendingChunks.count() > maximalPendingChunksCount && !m_failed)
+        writeChunk(m_pendingChunks.dequeue().result());
+}
+
+bool FlateStream::writeChunk(const CompressedChunk &chunk)
+{
+    if (!chunk.success) {
+        m_failed = true;
+        return false;
+    }
+    m_adler32 = quint32(adler32_combine(m_adler32, chunk.adler32, chunk.uncompressedSize));
+    return writeToDevice(chunk.data.constData(), chunk.data.size());
+}
+
+FlateStream::CompressedChunk FlateStream::deflateChunk(Types::DeflateBackends backend, const QByteArray &chunk, const QByteArray &previousChunk, int compressionLevel, bool isLastChunk)
+{
+    CompressedChunk result;
+    result.uncompressedSize = chunk.size();
+    result.adler32 = quint32(adler32(adler32(0, Z_NULL, 0), reinterpret_cast<const Bytef*>(chunk.constData()), uInt(chunk.size())));
+
+    // Negative window bits: raw deflate data without zlib header and trailer
+    QScopedPointer<Deflater> stream(Deflater::create(backend));
+    if (!stream || !stream->init(compressionLevel, -15))
+        return result;
+
+    if (!previousChunk.isEmpty()) {
+        const int dictionarySize = qMin(previousChunk.size(), deflateWindowSize);
+        stream->setDictionary(previousChunk.constData() + previousChunk.size() - dictionarySize, dictionarySize);
+    }
+
+    // The sync flush ends the chunk on a byte boundary without ending the
+    // deflate stream, so that the next chunk can be appended directly.
+    QByteArray compressed(int(stream->bound(chunk.size())) + 16, 0);
+    const char *input = chunk.constData();
+    uint inputSize = uint(chunk.size());
+    char *output = compressed.data();
+    uint outputSize = uint(compressed.size());
+    const int flush = isLastChunk ? Z_FINISH : Z_SYNC_FLUSH;
+    int deflateResult = stream->deflate(input, inputSize, output, outputSize, flush);
+    while (deflateResult == Z_OK && (outputSize == 0 || isLastChunk)) {
+        // Should not happen with bound(), but let's be safe
+        const int usedSize = compressed.size() - int(outputSize);
+        compressed.resize(compressed.size() * 2);
+        output = compressed.data() + usedSize;
+        outputSize = uint(compressed.size() - usedSize);
+        deflateResult = stream->deflate(input, inputSize, output, outputSize, flush);
+    }
+    const bool success = isLastChunk ? deflateResult == Z_STREAM_END : deflateResult == Z_OK || deflateResult == Z_BUF_ERROR;
+    compressed.resize(compressed.size() - int(outputSize));
+
+    result.data = compressed;
+    result.success = success;
+    return result;
+}
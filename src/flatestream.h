@@ -0,0 +1,103 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include "types.h"
+
+#include <QByteArray>
+#include <QFuture>
+#include <QQueue>
+#include <QScopedPointer>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+class QThreadPool;
+QT_END_NAMESPACE
+
+class Deflater;
+
+// Deflates data into the zlib format expected by the PDF FlateDecode filter
+// and writes the result directly to an output device. Only a fixed-size output
+// buffer is held, no matter how much data passes through.
+//
+// With a thread pool of more than one thread, the input is cut into chunks
+// which are deflated independently on that pool (like pigz does) and joined
+// into a single zlib stream. The pool is owned by the caller, so that all
+// streams of one document share the same threads. Each chunk is primed with
+// the end of the previous one, so the compression ratio stays close to the
+// single threaded one.
+//
+// The libdeflate backend can only compress whole buffers. It collects streams
+// up to a few megabytes, like image tiles, and deflates them in finish().
+// Larger streams continue with the best available streaming backend.
+class FlateStream
+{
+public:
+    FlateStream(QIODevice *outputDevice, int compressionLevel, QThreadPool *threadPool = nullptr,
+                Types::DeflateBackends backend = Types::DeflateBackendZlib);
+    ~FlateStream();
+
+    static bool isBackendAvailable(Types::DeflateBackends backend);
+
+    bool write(const char *data, qint64 length);
+    bool finish();
+    qint64 bytesWritten() const;
+
+private:
+    struct CompressedChunk {
+        QByteArray data;
+        quint32 adler32 = 0;
+        qint64 uncompressedSize = 0;
+        bool success = false;
+    };
+    static CompressedChunk deflateChunk(Types::DeflateBackends backend, const QByteArray &chunk, const QByteArray &previousChunk, int compressionLevel, bool isLastChunk);
+
+    void startStreaming();
+    bool continueAsStream();
+    bool writeStreaming(const char *data, qint64 length);
+    bool deflateData(const char *data, qint64 length, int flush);
+    bool deflateWholeBuffer();
+    bool writeToDevice(const char *data, qint64 length);
+    void enqueueChunk(bool isLastChunk);
+    bool writeChunk(const CompressedChunk &chunk);
+
+    QIODevice *m_outputDevice = nullptr;
+    int m_compressionLevel = 9;
+    QThreadPool *m_threadPool = nullptr;
+    Types::DeflateBackends m_backend = Types::DeflateBackendZlib;
+    bool m_streaming = false;
+    QScopedPointer<Deflater> m_stream;
+    QByteArray m_outputBuffer;
+    qint64 m_bytesWritten = 0;
+    bool m_finished = false;
+    bool m_failed = false;
+
+    // Only used by the libdeflate backend, before the stream gets too large
+    QByteArray m_wholeBuffer;
+
+    // Only used for parallel compression
+    QByteArray m_chunk;
+    QByteArray m_previousChunk;
+    QQueue<QFuture<CompressedChunk> > m_pendingChunks;
+    quint32 m_adler32 = 1;
+};
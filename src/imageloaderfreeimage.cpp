@@ -22,14 +22,16 @@
 
 #include "FreeImage.h"
 #include "imageloaderfreeimage.h"
+#include "pixelkernels.h"
 
-#include <QColor>
 #include <QStringList>
-#include <qendian.h>
+#include <QtConcurrent>
 
 #include <cmath>
+#include <numeric>
 
-static QString FreeImageErrorMessage;
+// Images may be loaded on several threads at once
+static thread_local QString FreeImageErrorMessage;
 
 void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message)
 {
@@ -71,6 +73,11 @@ void ImageLoaderFreeImage::disposeImage()
     }
 }
 
+ImageLoaderInterface *ImageLoaderFreeImage::create() const
+{
+    return new ImageLoaderFreeImage;
+}
+
 bool ImageLoaderFreeImage::loadInputImage(const QString &imageFileName, QString &errorMessage)
 {
     bool result = false;
@@ -78,7 +85,9 @@ bool ImageLoaderFreeImage::loadInputImage(const QString &imageFileName, QString
     FreeImageErrorMessage.clear();
 
     const FREE_IMAGE_FORMAT fileType = FreeImage_GetFileType(imageFileName.toAscii(), 0);
-    FIBITMAP* newImage = FreeImage_Load(fileType, imageFileName.toAscii(), TIFF_CMYK|JPEG_CMYK);
+    // Large images go into a TiledImage, because FreeImage would hold them whole
+    const bool isTiled = loadsTiled(imageFileName) && m_tiledImage.load(imageFileName);
+    FIBITMAP* newImage = isTiled ? nullptr : FreeImage_Load(fileType, imageFileName.toAscii(), TIFF_CMYK|JPEG_CMYK);
 
     // Filter out images which FreeImage can load but not convert to Rgb24
     // And images which we simply don't handle
@@ -93,17 +102,25 @@ bool ImageLoaderFreeImage::loadInputImage(const QString &imageFileName, QString
         }
     }
 
-    if (newImage) {
+    if (newImage || isTiled) {
         result = true;
         disposeImage();
+        if (!isTiled)
+            m_tiledImage.close();
 
         m_bitmap = newImage;
 
-        m_widthPixels = FreeImage_GetWidth(m_bitmap);
-        m_heightPixels = FreeImage_GetHeight(m_bitmap);
-
-        m_horizontalDotsPerMeter = FreeImage_GetDotsPerMeterX(m_bitmap);
-        m_verticalDotsPerMeter = FreeImage_GetDotsPerMeterY(m_bitmap);
+        if (isTiled) {
+            m_widthPixels = m_tiledImage.sizePixels().width();
+            m_heightPixels = m_tiledImage.sizePixels().height();
+            m_horizontalDotsPerMeter = m_tiledImage.header().dotsPerMeterX();
+            m_verticalDotsPerMeter = m_tiledImage.header().dotsPerMeterY();
+        } else {
+            m_widthPixels = FreeImage_GetWidth(m_bitmap);
+            m_heightPixels = FreeImage_GetHeight(m_bitmap);
+            m_horizontalDotsPerMeter = FreeImage_GetDotsPerMeterX(m_bitmap);
+            m_verticalDotsPerMeter = FreeImage_GetDotsPerMeterY(m_bitmap);
+        }
 
         if (m_horizontalDotsPerMeter == 0)
             m_horizontalDotsPerMeter = 2835; // 72 dpi
@@ -112,7 +129,16 @@ bool ImageLoaderFreeImage::loadInputImage(const QString &imageFileName, QString
 
         m_imageFileName = imageFileName;
 
-        if (colorDataType() == Types::ColorTypeRGB && bitsPerPixel() == 32) {
+        // Kept open, so that the poster embeds exactly this file
+        m_jpegFile.close();
+        m_passthroughImage.close();
+        if (fileType == FIF_JPEG)
+            m_jpegFile.open(imageFileName);
+        else if ((fileType == FIF_PNG || fileType == FIF_TIFF)
+                 && m_passthroughImage.open(imageFileName) && m_passthroughImage.sizePixels() != sizePixels())
+            m_passthroughImage.close();
+
+        if (m_bitmap && colorDataType() == Types::ColorTypeRGB && bitsPerPixel() == 32) {
             // Sometimes, there are strange .PSD images like this (FreeImage bug?)
             RGBQUAD white = { 255, 255, 255, 0 };
             FIBITMAP *Image24Bit = FreeImage_Composite(m_bitmap, FALSE, &white);
@@ -126,14 +152,111 @@ bool ImageLoaderFreeImage::loadInputImage(const QString &imageFileName, QString
     return result;
 }
 
+bool ImageLoaderFreeImage::readImageInfo(const QString &imageFileName, QSize &sizePixels, int &bitsPerPixel) const
+{
+#ifdef FIF_LOAD_NOPIXELS
+    const FREE_IMAGE_FORMAT fileType = FreeImage_GetFileType(imageFileName.toAscii(), 0);
+    if (fileType == FIF_UNKNOWN || !FreeImage_FIFSupportsNoPixels(fileType))
+        return false;
+    FIBITMAP* header = FreeImage_Load(fileType, imageFileName.toAscii(), FIF_LOAD_NOPIXELS|TIFF_CMYK|JPEG_CMYK);
+    if (!header)
+        return false;
+    sizePixels = QSize(FreeImage_GetWidth(header), FreeImage_GetHeight(header));
+    bitsPerPixel = FreeImage_GetBPP(header);
+    FreeImage_Unload(header);
+    return true;
+#else
+    Q_UNUSED(imageFileName)
+    Q_UNUSED(sizePixels)
+    Q_UNUSED(bitsPerPixel)
+    return false; // FreeImage before 3.16 can only load whole images
+#endif
+}
+
+// Images which would take more memory than TiledImage::minimumBytes are decoded
+// into a TiledImage instead, if it has a decoder for their format
+bool ImageLoaderFreeImage::loadsTiled(const QString &imageFileName) const
+{
+    QSize sizePixels;
+    int bitsPerPixel = 0;
+    return readImageInfo(imageFileName, sizePixels, bitsPerPixel)
+        && (qint64(sizePixels.width()) * bitsPerPixel + 31) / 32 * 4 * sizePixels.height() > TiledImage::minimumBytes
+        && TiledImage::canLoad(imageFileName);
+}
+
+qint64 ImageLoaderFreeImage::residentBytesCount(const QString &imageFileName) const
+{
+    if (loadsTiled(imageFileName))
+        return TiledImage::residentBytesCount();
+    QSize sizePixels;
+    int bitsPerPixel = 0;
+    if (!readImageInfo(imageFileName, sizePixels, bitsPerPixel))
+        return -1;
+    // FreeImage pads its scanlines to 32 bits
+    return qint64((sizePixels.width() * bitsPerPixel + 31) / 32) * 4 * sizePixels.height();
+}
+
+QImage ImageLoaderFreeImage::readPreviewImage(const QString &imageFileName, const QSize &boxSize) const
+{
+    const FREE_IMAGE_FORMAT fileType = FreeImage_GetFileType(imageFileName.toAscii(), 0);
+    FIBITMAP *preview = nullptr;
+    if (fileType == FIF_JPEG) {
+        // The size in the upper 16 bits lets libjpeg skip DCT coefficients, down to 1/8
+        const int size = qMin(qMax(boxSize.width(), boxSize.height()), 0xffff);
+        preview = FreeImage_Load(FIF_JPEG, imageFileName.toAscii(), JPEG_FAST | (size << 16));
+    }
+#ifdef FIF_LOAD_NOPIXELS
+    else if (fileType != FIF_UNKNOWN && FreeImage_FIFSupportsNoPixels(fileType)) {
+        // An EXIF or TIFF thumbnail is also read with the header
+        FIBITMAP *header = FreeImage_Load(fileType, imageFileName.toAscii(), FIF_LOAD_NOPIXELS);
+        if (header) {
+            if (FIBITMAP *thumbnail = FreeImage_GetThumbnail(header))
+                preview = FreeImage_Clone(thumbnail);
+            FreeImage_Unload(header);
+        }
+    }
+#endif
+    if (!preview)
+        return QImage();
+
+    FIBITMAP *preview24Bits = FreeImage_ConvertTo24Bits(preview);
+    FreeImage_Unload(preview);
+    if (!preview24Bits)
+        return QImage();
+    const int width = FreeImage_GetWidth(preview24Bits);
+    const int height = FreeImage_GetHeight(preview24Bits);
+    QImage result(width, height, QImage::Format_RGB32);
+    for (int scanline = 0; scanline < height; scanline++) {
+        QRgb *targetData = (QRgb*)result.scanLine(scanline);
+        const tagRGBTRIPLE *sourceRgb = (tagRGBTRIPLE*)FreeImage_GetScanLine(preview24Bits, height - scanline - 1);
+        for (int column = 0; column < width; column++) {
+            *targetData++ = qRgb(sourceRgb->rgbtRed, sourceRgb->rgbtGreen, sourceRgb->rgbtBlue);
+            sourceRgb++;
+        }
+    }
+    FreeImage_Unload(preview24Bits);
+
+    return result;
+}
+
 bool ImageLoaderFreeImage::isImageLoaded() const
 {
-    return (m_bitmap != nullptr);
+    return m_bitmap != nullptr || m_tiledImage.isOpen();
 }
 
 bool ImageLoaderFreeImage::isJpeg() const
 {
-    return FreeImage_GetFileType(m_imageFileName.toAscii(), 0) == FIF_JPEG;
+    return m_jpegFile.isOpen();
+}
+
+const MappedFile *ImageLoaderFreeImage::jpegFile() const
+{
+    return isJpeg() ? &m_jpegFile : nullptr;
+}
+
+const PassthroughImage *ImageLoaderFreeImage::passthroughImage() const
+{
+    return m_passthroughImage.isOpen() ? &m_passthroughImage : nullptr;
 }
 
 QString ImageLoaderFreeImage::fileName() const
@@ -164,45 +287,52 @@ QSizeF ImageLoaderFreeImage::size(Types::UnitsOfLength unit) const
 
 const QImage ImageLoaderFreeImage::imageAsRGB(const QSize &size) const
 {
-    const QSize resultSize = size.isValid() ? size : sizePixels();
+    return imageAsRGB(QRect(QPoint(), sizePixels()), size);
+}
+
+const QImage ImageLoaderFreeImage::imageAsRGB(const QRect &sourceRect, const QSize &size) const
+{
+    const QSize resultSize = size.isValid() ? size : sourceRect.size();
+    if (m_tiledImage.isOpen())
+        return m_tiledImage.imageAsRGB(sourceRect, resultSize);
     const bool isRGB24 = colorDataType() == Types::ColorTypeRGB && bitsPerPixel() == 24;
     const bool isARGB32 = colorDataType() == Types::ColorTypeRGBA && bitsPerPixel() == 32;
     QImage result(resultSize, isARGB32 ? QImage::Format_ARGB32 : QImage::Format_RGB32);
 
     const int width = resultSize.width();
     const int height = resultSize.height();
-    const QSize sizePixels = this->sizePixels();
+    const QSize sizePixels = sourceRect.size();
 
     FIBITMAP* originalImage = m_bitmap;
-    FIBITMAP* temp24BPPImage = nullptr;
+    FIBITMAP* croppedImage = nullptr;
+    FIBITMAP* convertedImage = nullptr;
     FIBITMAP* scaledImage = nullptr;
+    bool holdsQRgbs = false;
+
+    if (sourceRect != QRect(QPoint(), this->sizePixels())) {
+        // FreeImage_Copy() takes top down coordinates, with right and bottom exclusive
+        croppedImage = FreeImage_Copy(m_bitmap, sourceRect.left(), sourceRect.top(), sourceRect.right() + 1, sourceRect.bottom() + 1);
+        originalImage = croppedImage;
+    }
 
     if (!(isRGB24 || isARGB32)) {
         if (colorDataType() == Types::ColorTypeCMYK) {
             const bool isCmykJpeg = isJpeg(); // Value range inverted
-            temp24BPPImage = FreeImage_Allocate(sizePixels.width(), sizePixels.height(), 24);
-            const unsigned int columnsCount = sizePixels.width();
-            const unsigned int scanlinesCount = sizePixels.height();
-            for (unsigned int scanline = 0; scanline < scanlinesCount; scanline++) {
-                const BYTE* const cmykBits = FreeImage_GetScanLine(m_bitmap, scanline);
-                tagRGBTRIPLE* const rgbBits = (tagRGBTRIPLE *)FreeImage_GetScanLine(temp24BPPImage, scanline);
-
-                for (unsigned int column = 0; column < columnsCount; column++) {
-                    const unsigned int cmykColumn = column * 4;
-
-                    const QColor rgbColor = isCmykJpeg ?
-                        QColor::fromCmyk(255 - cmykBits[cmykColumn], 255 - cmykBits[cmykColumn + 1], 255 - cmykBits[cmykColumn + 2], 255 - cmykBits[cmykColumn + 3])
-                        : QColor::fromCmyk(cmykBits[cmykColumn], cmykBits[cmykColumn + 1], cmykBits[cmykColumn + 2], cmykBits[cmykColumn + 3]);
-
-                    rgbBits[column].rgbtRed = (BYTE)rgbColor.red();
-                    rgbBits[column].rgbtGreen = (BYTE)rgbColor.green();
-                    rgbBits[column].rgbtBlue = (BYTE)rgbColor.blue();
-                }
-            }
+            // Holds QRgbs rather than FreeImage pixels. Rescaling does not care about the channel order
+            convertedImage = FreeImage_Allocate(sizePixels.width(), sizePixels.height(), 32);
+            holdsQRgbs = true;
+            const int columnsCount = sizePixels.width();
+            QVector<int> scanlines(sizePixels.height());
+            std::iota(scanlines.begin(), scanlines.end(), 0);
+            QtConcurrent::blockingMap(scanlines, [&] (int scanline) {
+                PixelKernels::cmykToRgb(FreeImage_GetScanLine(originalImage, scanline),
+                                        reinterpret_cast<QRgb*>(FreeImage_GetScanLine(convertedImage, scanline)),
+                                        columnsCount, isCmykJpeg);
+            });
         } else {
-            temp24BPPImage = FreeImage_ConvertTo24Bits(originalImage);
+            convertedImage = FreeImage_ConvertTo24Bits(originalImage);
         }
-        originalImage = temp24BPPImage;
+        originalImage = convertedImage;
     }
 
     if (resultSize != sizePixels) {
@@ -212,7 +342,9 @@ const QImage ImageLoaderFreeImage::imageAsRGB(const QSize &size) const
 
     for (int scanline = 0; scanline < height; scanline++) {
         QRgb *targetData = (QRgb*)result.scanLine(scanline);
-        if (isARGB32) {
+        if (holdsQRgbs) {
+            memcpy(targetData, FreeImage_GetScanLine(originalImage, height - scanline - 1), width * sizeof(QRgb));
+        } else if (isARGB32) {
             const tagRGBQUAD *sourceRgba = (tagRGBQUAD*)FreeImage_GetScanLine(originalImage, height - scanline - 1);
             for (int column = 0; column < width; column++) {
                 *targetData++ = qRgba(sourceRgba->rgbRed, sourceRgba->rgbGreen, sourceRgba->rgbBlue, sourceRgba->rgbReserved);
@@ -227,8 +359,11 @@ const QImage ImageLoaderFreeImage::imageAsRGB(const QSize &size) const
         }
     }
 
-    if (temp24BPPImage)
-        FreeImage_Unload(temp24BPPImage);
+    if (croppedImage)
+        FreeImage_Unload(croppedImage);
+
+    if (convertedImage)
+        FreeImage_Unload(convertedImage);
 
     if (scaledImage)
         FreeImage_Unload(scaledImage);
@@ -238,11 +373,16 @@ const QImage ImageLoaderFreeImage::imageAsRGB(const QSize &size) const
 
 int ImageLoaderFreeImage::bitsPerPixel() const
 {
+    if (m_tiledImage.isOpen())
+        return m_tiledImage.bitsPerPixel();
     return FreeImage_GetBPP(m_bitmap);
 }
 
 Types::ColorTypes ImageLoaderFreeImage::colorDataType() const
 {
+    if (m_tiledImage.isOpen())
+        return m_tiledImage.colorDataType();
+
     Types::ColorTypes colorDatatype = Types::ColorTypeRGB;
     const FREE_IMAGE_COLOR_TYPE imageColorType = FreeImage_GetColorType(m_bitmap);
 
@@ -261,48 +401,53 @@ Types::ColorTypes ImageLoaderFreeImage::colorDataType() const
 
 const QByteArray ImageLoaderFreeImage::bits() const
 {
-    const unsigned int bitsPerLine = m_widthPixels * bitsPerPixel();
-    const unsigned int bytesPerLine = (unsigned int)ceil(bitsPerLine/8.0);
-    const unsigned int imageBytesCount = bytesPerLine * m_heightPixels;
+    // The tiled rows are not padded
+    const unsigned int bytesPerLine = m_tiledImage.isOpen() ? (m_widthPixels * bitsPerPixel() + 7) / 8 : FreeImage_GetLine(m_bitmap);
+    const qint64 imageBytesCount = qint64(bytesPerLine) * m_heightPixels;
+
+    QByteArray result(int(imageBytesCount), 0);
+    readScanlines(0, m_heightPixels, result.data());
+    return result;
+}
+
+void ImageLoaderFreeImage::readScanlines(int firstScanline, int scanlinesCount, char *destination) const
+{
+    if (m_tiledImage.isOpen()) {
+        m_tiledImage.readScanlines(firstScanline, scanlinesCount, destination);
+        return;
+    }
 
-    QByteArray result(imageBytesCount, 0);
-    char *destination = result.data();
-    FreeImage_ConvertToRawBits((BYTE*)destination, m_bitmap, bytesPerLine, bitsPerPixel(), FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, hasFreeImageVersionCorrectTopDownInConvertBits());
+    const unsigned int bytesPerLine = FreeImage_GetLine(m_bitmap);
+    const Types::ColorTypes colorType = colorDataType();
+    const int bitsPerPixel = this->bitsPerPixel();
 
-    const unsigned int numberOfPixels = m_widthPixels * m_heightPixels;
+    for (int scanline = firstScanline; scanline < firstScanline + scanlinesCount; scanline++) {
+        uchar *line = reinterpret_cast<uchar*>(destination);
+        // FreeImage stores the bottom scanline first
+        memcpy(line, FreeImage_GetScanLine(m_bitmap, m_heightPixels - scanline - 1), bytesPerLine);
 #if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-    if (colorDataType() == Types::ColorTypeRGB && bitsPerPixel() == 24) {
-        for (unsigned int pixelIndex = 0; pixelIndex < numberOfPixels; pixelIndex++) {
-            char *pixelPtr = destination + pixelIndex*3;
-            const char temp = pixelPtr[0];
-            pixelPtr[0] = pixelPtr[2];
-            pixelPtr[2] = temp;
-            pixelPtr+=3;
-        }
-    } else if (colorDataType() == Types::ColorTypeRGBA && bitsPerPixel() == 32) {
-        auto argbDestination = (unsigned int*)destination;
-        for (unsigned int pixelIndex = 0; pixelIndex < numberOfPixels; pixelIndex++) {
-            *argbDestination = qToBigEndian(*argbDestination);
-            argbDestination++;
-        }
-    } else
+        if (colorType == Types::ColorTypeRGB && bitsPerPixel == 24)
+            PixelKernels::bgrToRgb(line, line, m_widthPixels);
+        else if (colorType == Types::ColorTypeRGBA && bitsPerPixel == 32)
+            PixelKernels::bgraToArgb(line, line, m_widthPixels);
+        else
 #endif // FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-    if (colorDataType() == Types::ColorTypeRGB && bitsPerPixel() == 48) {
-        // Apparently, the 48 bit data has to be reordered on Windows and ppc/i386 OSX
-        // TODO: So maybe this swap belongs into the PDFwriter. Investigate.
-        auto rgb48Destination = (unsigned short*)destination;
-        const unsigned long numberOfSwaps = numberOfPixels * 3; // Words are swapped
-        for (unsigned int pixelIndex = 0; pixelIndex < numberOfSwaps; pixelIndex++) {
-            *rgb48Destination = qToBigEndian(*rgb48Destination);
-            rgb48Destination++;
+        if (colorType == Types::ColorTypeRGB && bitsPerPixel == 48) {
+            // Apparently, the 48 bit data has to be reordered on Windows and ppc/i386 OSX
+            // TODO: So maybe this swap belongs into the PDFwriter. Investigate.
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+            PixelKernels::byteSwap16(reinterpret_cast<quint16*>(line), reinterpret_cast<quint16*>(line), m_widthPixels * 3); // Words are swapped
+#endif
         }
+        destination += bytesPerLine;
     }
-
-    return result;
 }
 
 const QVector<QRgb> ImageLoaderFreeImage::colorTable() const
 {
+    if (m_tiledImage.isOpen())
+        return m_tiledImage.header().colorTable();
+
     QVector<QRgb> result;
 
     const RGBQUAD* const palette = FreeImage_GetPalette(m_bitmap);
@@ -333,10 +478,6 @@ const QVector<QPair<QStringList, QString> > &ImageLoaderFreeImage::imageFormats(
     return formats;
 }
 
-bool ImageLoaderFreeImage::hasFreeImageVersionCorrectTopDownInConvertBits()
-{
-    return FREEIMAGE_MAJOR_VERSION >= 3 && FREEIMAGE_MINOR_VERSION >= 10;
-}
 QString ImageLoaderFreeImage::libraryName() const
 {
     return QLatin1String("FreeImage");
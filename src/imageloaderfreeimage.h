@@ -23,6 +23,9 @@
 #pragma once
 
 #include "imageloaderinterface.h"
+#include "mappedfile.h"
+#include "passthroughimage.h"
+#include "tiledimage.h"
 
 struct FIBITMAP;
 
@@ -32,31 +35,43 @@ public:
     ImageLoaderFreeImage(QObject *parent = nullptr);
     ~ImageLoaderFreeImage() override;
 
+    ImageLoaderInterface *create() const override;
     bool loadInputImage(const QString &imageFileName, QString &errorMessage) override;
+    bool readImageInfo(const QString &imageFileName, QSize &sizePixels, int &bitsPerPixel) const override;
+    qint64 residentBytesCount(const QString &imageFileName) const override;
+    QImage readPreviewImage(const QString &imageFileName, const QSize &boxSize) const override;
     bool isImageLoaded() const override;
     bool isJpeg() const override;
+    const MappedFile *jpegFile() const override;
+    const PassthroughImage *passthroughImage() const override;
     QString fileName() const override;
     QSize sizePixels() const override;
     qreal horizontalDotsPerUnitOfLength(Types::UnitsOfLength unit) const override;
     qreal verticalDotsPerUnitOfLength(Types::UnitsOfLength unit) const override;
     QSizeF size(Types::UnitsOfLength unit) const override;
     const QImage imageAsRGB(const QSize &size) const override;
+    const QImage imageAsRGB(const QRect &sourceRect, const QSize &size) const override;
     int bitsPerPixel() const override;
     Types::ColorTypes colorDataType() const override;
     const QByteArray bits() const override;
+    void readScanlines(int firstScanline, int scanlinesCount, char *destination) const override;
     const QVector<QRgb> colorTable() const override;
     const QVector<QPair<QStringList, QString> > &imageFormats() const override;
     QString libraryName() const override;
     QString libraryAboutText() const override;
 
 private:
-    FIBITMAP* m_bitmap = nullptr;
+    bool loadsTiled(const QString &imageFileName) const;
+
+    FIBITMAP* m_bitmap = nullptr; // nullptr while the image is in m_tiledImage
+    TiledImage m_tiledImage;
     int m_widthPixels = 0;
     int m_heightPixels = 0;
     unsigned int m_horizontalDotsPerMeter = 0;
     unsigned int m_verticalDotsPerMeter = 0;
     QString m_imageFileName;
+    MappedFile m_jpegFile;
+    PassthroughImage m_passthroughImage;
 
     void disposeImage();
-    static bool hasFreeImageVersionCorrectTopDownInConvertBits();
 };
@@ -25,6 +25,9 @@
 #include "types.h"
 #include <QImage>
 
+class MappedFile;
+class PassthroughImage;
+
 QT_BEGIN_NAMESPACE
 class PainterInterface;
 QT_END_NAMESPACE
@@ -34,18 +37,35 @@ class ImageLoaderInterface
 public:
     virtual ~ImageLoaderInterface() = default;
 
+    // A new loader of the same kind, without image. For loading on another thread
+    virtual ImageLoaderInterface *create() const = 0;
     virtual bool loadInputImage(const QString &imageFileName, QString &errorMessage) = 0;
+    // Reads only the header, does not change the loaded image
+    virtual bool readImageInfo(const QString &imageFileName, QSize &sizePixels, int &bitsPerPixel) const = 0;
+    // The memory which loadInputImage() would keep for the image, from the header only. -1 if unknown
+    virtual qint64 residentBytesCount(const QString &imageFileName) const = 0;
+    // Quickly reads a low resolution preview of about boxSize, by a scaled decode or from an
+    // embedded thumbnail. Does not change the loaded image. A null image if there is no quick way
+    virtual QImage readPreviewImage(const QString &imageFileName, const QSize &boxSize) const = 0;
     virtual bool isImageLoaded() const = 0;
     virtual bool isJpeg() const = 0;
+    // The loaded JPEG file, mapped at load time. nullptr for other images
+    virtual const MappedFile *jpegFile() const = 0;
+    // The compressed data of the loaded file if a PDF can embed it as it is. nullptr otherwise
+    virtual const PassthroughImage *passthroughImage() const = 0;
     virtual QString fileName() const = 0;
     virtual QSize sizePixels() const = 0;
     virtual qreal horizontalDotsPerUnitOfLength(Types::UnitsOfLength unit) const = 0;
     virtual qreal verticalDotsPerUnitOfLength(Types::UnitsOfLength unit) const = 0;
     virtual QSizeF size(Types::UnitsOfLength unit) const = 0;
     virtual const QImage imageAsRGB(const QSize &size) const = 0;
+    // The part sourceRect of the image, scaled to size. Safe to call from several threads at once
+    virtual const QImage imageAsRGB(const QRect &sourceRect, const QSize &size) const = 0;
     virtual int bitsPerPixel() const = 0;
     virtual Types::ColorTypes colorDataType() const = 0;
     virtual const QByteArray bits() const = 0;
+    // Writes scanlinesCount rows of bits(), starting at firstScanline, to destination
+    virtual void readScanlines(int firstScanline, int scanlinesCount, char *destination) const = 0;
     virtual const QVector<QRgb> colorTable() const = 0;
     virtual const QVector<QPair<QStringList, QString> > &imageFormats() const = 0;
     virtual QString libraryName() const = 0;
@@ -21,6 +21,7 @@
 */
 
 #include "imageloaderqt.h"
+#include "pixelkernels.h"
 
 #include <QImageReader>
 #ifdef POPPLER_QT5_LIB
@@ -28,6 +29,18 @@
 #endif
 #include <cmath>
 
+// Images which would take more memory than TiledImage::minimumBytes are decoded
+// into a TiledImage, if it has a decoder for their format: JPEG, PNG and TIFF,
+// depending on the libraries of the build. All others are loaded whole.
+static bool loadsTiled(const QImageReader &reader)
+{
+    const QImage::Format readerFormat = reader.imageFormat();
+    const int readerBitsPerPixel = readerFormat == QImage::Format_Invalid ? 32 : QImage::toPixelFormat(readerFormat).bitsPerPixel();
+    return reader.size().isValid()
+        && qint64(reader.size().width()) * reader.size().height() * readerBitsPerPixel / 8 > TiledImage::minimumBytes
+        && TiledImage::canLoad(reader.fileName());
+}
+
 ImageLoaderQt::ImageLoaderQt(QObject *parent)
     : QObject(parent)
 {
@@ -56,6 +69,7 @@ bool ImageLoaderQt::loadPdf(const QString &imageFileName, QString &errorMessage)
       return false;
 
     // FIXME: Don't hard-wire the resolution, and display correct resolution!
+    m_tiledImage.close();
     m_image = pdfPage->renderToImage(300.0, 300.0);
     if (m_image.isNull())
       return false;
@@ -64,10 +78,17 @@ bool ImageLoaderQt::loadPdf(const QString &imageFileName, QString &errorMessage)
     delete document;
 
     m_imageFileName = imageFileName;
+    m_jpegFile.close();
+    m_passthroughImage.close();
     return true;
 }
 #endif // POPPLER_QT5_LIB
 
+ImageLoaderInterface *ImageLoaderQt::create() const
+{
+    return new ImageLoaderQt;
+}
+
 bool ImageLoaderQt::loadInputImage(const QString &imageFileName, QString &errorMessage)
 {
     Q_UNUSED(errorMessage)
@@ -75,21 +96,86 @@ bool ImageLoaderQt::loadInputImage(const QString &imageFileName, QString &errorM
     if(imageFileName.endsWith(QStringLiteral(".pdf"), Qt::CaseInsensitive))
       return loadPdf(imageFileName, errorMessage);
 #endif
-    bool result = m_image.load(imageFileName);
-    if (result)
+    m_tiledImage.close();
+    m_image = QImage();
+    bool result = loadsTiled(QImageReader(imageFileName)) ? m_tiledImage.load(imageFileName) : m_image.load(imageFileName);
+    if (result) {
         m_imageFileName = imageFileName;
+        // Kept open, so that the poster embeds exactly this file
+        m_jpegFile.close();
+        m_passthroughImage.close();
+        const QByteArray format = QImageReader(imageFileName).format();
+        if (format == "jpeg")
+            m_jpegFile.open(imageFileName);
+        else if ((format == "png" || format == "tiff")
+                 && m_passthroughImage.open(imageFileName) && m_passthroughImage.sizePixels() != sizePixels())
+            m_passthroughImage.close();
+    }
     return result;
 }
 
+const QImage &ImageLoaderQt::imageHeader() const
+{
+    return m_tiledImage.isOpen() ? m_tiledImage.header() : m_image;
+}
+
+bool ImageLoaderQt::readImageInfo(const QString &imageFileName, QSize &sizePixels, int &bitsPerPixel) const
+{
+    const QImageReader reader(imageFileName);
+    if (!reader.canRead() || !reader.size().isValid())
+        return false;
+    sizePixels = reader.size();
+    // The depth of the QImage which loadInputImage() will hold
+    const QImage::Format format = reader.imageFormat();
+    bitsPerPixel = format == QImage::Format_Invalid ? 32 : QImage::toPixelFormat(format).bitsPerPixel();
+    return true;
+}
+
+qint64 ImageLoaderQt::residentBytesCount(const QString &imageFileName) const
+{
+    const QImageReader reader(imageFileName);
+    if (loadsTiled(reader))
+        return TiledImage::residentBytesCount();
+    QSize sizePixels;
+    int bitsPerPixel = 0;
+    if (!readImageInfo(imageFileName, sizePixels, bitsPerPixel))
+        return -1;
+    return qint64((sizePixels.width() * bitsPerPixel + 31) / 32) * 4 * sizePixels.height();
+}
+
+QImage ImageLoaderQt::readPreviewImage(const QString &imageFileName, const QSize &boxSize) const
+{
+    QImageReader reader(imageFileName);
+    // The JPEG decoder skips DCT coefficients for a scaled size. Other formats
+    // would decode the whole image anyway
+    if (reader.format() != "jpeg" || !reader.supportsOption(QImageIOHandler::ScaledSize))
+        return QImage();
+    const QSize sizePixels = reader.size();
+    if (!sizePixels.isValid())
+        return QImage();
+    if (sizePixels.width() > boxSize.width() || sizePixels.height() > boxSize.height())
+        reader.setScaledSize(sizePixels.scaled(boxSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1)));
+    return reader.read();
+}
+
 bool ImageLoaderQt::isImageLoaded() const
 {
-    return !m_image.isNull();
+    return !m_image.isNull() || m_tiledImage.isOpen();
 }
 
 bool ImageLoaderQt::isJpeg() const
 {
-    QImageReader reader(m_imageFileName);
-    return reader.format() == "jpeg";
+    return m_jpegFile.isOpen();
+}
+
+const MappedFile *ImageLoaderQt::jpegFile() const
+{
+    return isJpeg() ? &m_jpegFile : nullptr;
+}
+
+const PassthroughImage *ImageLoaderQt::passthroughImage() const
+{
+    return m_passthroughImage.isOpen() ? &m_passthroughImage : nullptr;
 }
 
 QString ImageLoaderQt::fileName() const
@@ -99,17 +185,17 @@ QString ImageLoaderQt::fileName() const
 
 QSize ImageLoaderQt::sizePixels() const
 {
-    return m_image.size();
+    return m_tiledImage.isOpen() ? m_tiledImage.sizePixels() : m_image.size();
 }
 
 qreal ImageLoaderQt::horizontalDotsPerUnitOfLength(Types::UnitsOfLength unit) const
 {
-    return m_image.logicalDpiX() / Types::convertBetweenUnitsOfLength(1, Types::UnitOfLengthInch, unit);
+    return imageHeader().logicalDpiX() / Types::convertBetweenUnitsOfLength(1, Types::UnitOfLengthInch, unit);
 }
 
 qreal ImageLoaderQt::verticalDotsPerUnitOfLength(Types::UnitsOfLength unit) const
 {
-    return m_image.logicalDpiY() / Types::convertBetweenUnitsOfLength(1, Types::UnitOfLengthInch, unit);
+    return imageHeader().logicalDpiY() / Types::convertBetweenUnitsOfLength(1, Types::UnitOfLengthInch, unit);
 }
 
 QSizeF ImageLoaderQt::size(Types::UnitsOfLength unit) const
@@ -123,24 +209,34 @@ QSizeF ImageLoaderQt::size(Types::UnitsOfLength unit) const
 
 const QImage ImageLoaderQt::imageAsRGB(const QSize &size) const
 {
+    if (m_tiledImage.isOpen())
+        return m_tiledImage.imageAsRGB(QRect(QPoint(), sizePixels()), size);
     return m_image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
 }
 
+const QImage ImageLoaderQt::imageAsRGB(const QRect &sourceRect, const QSize &size) const
+{
+    if (m_tiledImage.isOpen())
+        return m_tiledImage.imageAsRGB(sourceRect, size);
+    return m_image.copy(sourceRect).scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
 int ImageLoaderQt::bitsPerPixel() const
 {
-    return colorDataType() == Types::ColorTypeRGB ? 24 : m_image.depth();
+    return colorDataType() == Types::ColorTypeRGB ? 24 : imageHeader().depth();
 }
 
 Types::ColorTypes ImageLoaderQt::colorDataType() const
 {
     Types::ColorTypes result = Types::ColorTypeRGB;
-    switch (m_image.format())
+    const QImage &imageHeader = this->imageHeader();
+    switch (imageHeader.format())
     {
     case QImage::Format_Mono:
         result = Types::ColorTypeMonochrome;
         break;
     case QImage::Format_Indexed8:
-        result = m_image.isGrayscale() ? Types::ColorTypeGreyscale : Types::ColorTypePalette;
+        result = imageHeader.isGrayscale() ? Types::ColorTypeGreyscale : Types::ColorTypePalette;
         break;
     case QImage::Format_ARGB32:
         result = Types::ColorTypeRGBA;
@@ -153,42 +249,44 @@ Types::ColorTypes ImageLoaderQt::colorDataType() const
 
 const QByteArray ImageLoaderQt::bits() const
 {
-    const int imageWidth = m_image.width();
-    const int imageHeight = m_image.height();
-    const unsigned int bitsPerLine = imageWidth * bitsPerPixel();
+    const QSize sizePixels = this->sizePixels();
+    const unsigned int bitsPerLine = sizePixels.width() * bitsPerPixel();
     const unsigned int bytesPerLine = (unsigned int)ceil(bitsPerLine/8.0);
-    const unsigned int imageBytesCount = bytesPerLine * imageHeight;
+    const qint64 imageBytesCount = qint64(bytesPerLine) * sizePixels.height();
 
-    QByteArray result(imageBytesCount, 0);
-    char *destination = result.data();
+    QByteArray result(int(imageBytesCount), 0);
+    readScanlines(0, sizePixels.height(), result.data());
+    return result;
+}
+
+void ImageLoaderQt::readScanlines(int firstScanline, int scanlinesCount, char *destination) const
+{
+    if (m_tiledImage.isOpen()) {
+        m_tiledImage.readScanlines(firstScanline, scanlinesCount, destination);
+        return;
+    }
+
+    const int imageWidth = sizePixels().width();
+    const unsigned int bitsPerLine = imageWidth * bitsPerPixel();
+    const unsigned int bytesPerLine = (unsigned int)ceil(bitsPerLine/8.0);
 
     const bool has32Bpp = bitsPerPixel() == 32;
-    if ((bitsPerPixel() == 24 || has32Bpp) && QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
-        for (int scanline = 0; scanline < imageHeight; scanline++) {
-            const uchar *sourceScanLine = m_image.scanLine(scanline);
-            for (int column = 0; column < imageWidth; column++) {
-                if (has32Bpp)
-                    *destination++ = sourceScanLine[3];
-                *destination++ = sourceScanLine[2];
-                *destination++ = sourceScanLine[1];
-                *destination++ = sourceScanLine[0];
-                sourceScanLine += 4;
-            }
-        }
-    } else {
-        for (int scanline = 0; scanline < imageHeight; scanline++) {
-            const uchar *sourceScanLine = m_image.scanLine(scanline);
+    const bool swizzle = (bitsPerPixel() == 24 || has32Bpp) && QSysInfo::ByteOrder == QSysInfo::LittleEndian;
+    for (int scanline = firstScanline; scanline < firstScanline + scanlinesCount; scanline++) {
+        const uchar *sourceScanLine = m_image.constScanLine(scanline);
+        if (!swizzle)
             memcpy(destination, sourceScanLine, bytesPerLine);
-            destination += bytesPerLine;
-        }
+        else if (has32Bpp)
+            PixelKernels::bgraToArgb(sourceScanLine, reinterpret_cast<uchar*>(destination), imageWidth);
+        else
+            PixelKernels::bgraToRgb(sourceScanLine, reinterpret_cast<uchar*>(destination), imageWidth);
+        destination += bytesPerLine;
     }
-
-    return result;
 }
 
 const QVector<QRgb> ImageLoaderQt::colorTable() const
 {
-    return m_image.colorTable();
+    return imageHeader().colorTable();
 }
 
 const QVector<QPair<QStringList, QString> > &ImageLoaderQt::imageFormats() const
@@ -247,5 +345,8 @@ QString ImageLoaderQt::libraryAboutText() const
 
 void ImageLoaderQt::setQImage(const QImage &image)
 {
+    m_tiledImage.close();
     m_image = image;
+    m_jpegFile.close();
+    m_passthroughImage.close();
 }
@@ -23,6 +23,9 @@
 #pragma once
 
 #include "imageloaderinterface.h"
+#include "mappedfile.h"
+#include "passthroughimage.h"
+#include "tiledimage.h"
 #include <QObject>
 
 class ImageLoaderQt: public QObject, public ImageLoaderInterface
@@ -30,19 +33,27 @@ class ImageLoaderQt: public QObject, public ImageLoaderInterface
 public:
     ImageLoaderQt(QObject *parent = nullptr);
 
+    ImageLoaderInterface *create() const override;
     bool loadInputImage(const QString &imageFileName, QString &errorMessage) override;
+    bool readImageInfo(const QString &imageFileName, QSize &sizePixels, int &bitsPerPixel) const override;
+    qint64 residentBytesCount(const QString &imageFileName) const override;
+    QImage readPreviewImage(const QString &imageFileName, const QSize &boxSize) const override;
     bool isImageLoaded() const override;
     bool isJpeg() const override;
+    const MappedFile *jpegFile() const override;
+    const PassthroughImage *passthroughImage() const override;
     QString fileName() const override;
     QSize sizePixels() const override;
     qreal horizontalDotsPerUnitOfLength(Types::UnitsOfLength unit) const override;
     qreal verticalDotsPerUnitOfLength(Types::UnitsOfLength unit) const override;
     QSizeF size(Types::UnitsOfLength unit) const override;
     const QImage imageAsRGB(const QSize &size) const override;
+    const QImage imageAsRGB(const QRect &sourceRect, const QSize &size) const override;
     int bitsPerPixel() const override;
     Types::ColorTypes colorDataType() const override;
     int savePoster(const QString &fileName, const PainterInterface *painter, int pagesCount, const QSizeF &sizeCm) const;
     const QByteArray bits() const override;
+    void readScanlines(int firstScanline, int scanlinesCount, char *destination) const override;
     const QVector<QRgb> colorTable() const override;
     const QVector<QPair<QStringList, QString> > &imageFormats() const override;
     QString libraryName() const override;
@@ -54,7 +65,11 @@ private:
 #ifdef POPPLER_QT5_LIB
     bool loadPdf(const QString &imageFileName, QString &errorMessage);
 #endif
+    const QImage &imageHeader() const;
 
-    QImage m_image;
+    QImage m_image; // Null while the image is in m_tiledImage
+    TiledImage m_tiledImage;
     QString m_imageFileName;
+    MappedFile m_jpegFile;
+    PassthroughImage m_passthroughImage;
 };
@@ -20,6 +20,7 @@
     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 */
 
+#include "commandline.h"
 #include "controller.h"
 #include "mainwindow.h"
 #include "posterazorcore.h"
@@ -31,22 +32,28 @@
 
 #include <QtGui>
 
+#if defined (FREEIMAGE_LIB)
+typedef ImageLoaderFreeImage ImageLoader;
+#else
+typedef ImageLoaderQt ImageLoader;
+#endif
+
 int main (int argc, char **argv)
 {
+    QCoreApplication::setApplicationName(QLatin1String("PosteRazor"));
+    QCoreApplication::setApplicationVersion(QLatin1String("1.9.7"));
+    QCoreApplication::setOrganizationName(QLatin1String("CasaPortale"));
+    QCoreApplication::setOrganizationDomain(QLatin1String("de.casaportale"));
+
+    if (CommandLine::isBatchModeRequested(argc, argv)) {
+        // No QApplication, no widgets. Just the core and an image loader
+        QCoreApplication a(argc, argv);
+        return CommandLine::exec([] () -> ImageLoaderInterface* { return new ImageLoader; });
+    }
+
     QApplication a(argc, argv);
 
 #if 0
-    Q_ASSERT(argc == 3);
-    PosteRazorCore posteRazorCore;
-    QString loadErrorMessage;
-    const bool loaded = posteRazorCore.loadInputImage(argv[1], loadErrorMessage);
-    Q_ASSERT(loaded);
-    if (loaded) {
-        const int err = posteRazorCore.savePoster(argv[2]);
-        Q_ASSERT(err == 0);
-    }
-    return 0;
-#elif 0
     QImage image(512, 512, QImage::Format_ARGB32);
     image.fill(Qt::white);
     QRadialGradient gradient(image.rect().center(), image.width());
@@ -65,19 +72,8 @@ int main (int argc, char **argv)
     wizard.show();
     return a.exec();
 #else
-
-    QCoreApplication::setApplicationName(QLatin1String("PosteRazor"));
-    QCoreApplication::setApplicationVersion(QLatin1String("1.9.7"));
-    QCoreApplication::setOrganizationName(QLatin1String("CasaPortale"));
-    QCoreApplication::setOrganizationDomain(QLatin1String("de.casaportale"));
-
     MainWindow dialog;
-#if defined (FREEIMAGE_LIB)
-    ImageLoaderFreeImage
-#else
-    ImageLoaderQt
-#endif
-        imageLoader;
+    ImageLoader imageLoader;
     PosteRazorCore posteRazorCore(&imageLoader);
     Controller controller(&posteRazorCore, &dialog);
 
@@ -92,7 +88,7 @@ int main (int argc, char **argv)
 
     dialog.show();
     if (argc == 2)
-        controller.loadInputImage(QString::fromLocal8Bit(argv[1]));
+        controller.startLoadingInputImage(QString::fromLocal8Bit(argv[1]));
 
     const int appReturn = a.exec();
     dialog.writeSettings(&settings);
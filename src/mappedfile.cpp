@@ -0,0 +1,144 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "mappedfile.h"
+
+#if defined (Q_OS_LINUX)
+#   include <sys/sendfile.h>
+#   include <unistd.h>
+#endif
+
+// Large enough that the per-call overhead vanishes, small enough to not
+// force the whole file into memory at once where it is not mapped
+const qint64 sliceSize = 16 * 1024 * 1024;
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const QString &fileName)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+    m_size = m_file.size();
+    if (m_size > 0)
+        m_data = m_file.map(0, m_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+qint64 MappedFile::size() const
+{
+    return m_size;
+}
+
+const uchar *MappedFile::data() const
+{
+    return m_data;
+}
+
+#if defined (Q_OS_LINUX)
+// Lets the kernel copy between the files, without passing the bytes through user space.
+// Returns how many bytes were copied, which may be less than size if it is not supported.
+static qint64 copyBetweenFiles(int inputHandle, qint64 offset, int outputHandle, qint64 size)
+{
+    qint64 copied = 0;
+#if defined (__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 27)
+    loff_t inputOffset = offset;
+    while (copied < size) {
+        // Fails with EXDEV across file systems on kernels before 5.3
+        const ssize_t count = copy_file_range(inputHandle, &inputOffset, outputHandle, nullptr, size_t(size - copied), 0);
+        if (count <= 0)
+            break;
+        copied += count;
+    }
+#endif
+#endif
+    while (copied < size) {
+        off_t inputOffset = off_t(offset + copied);
+        const ssize_t count = sendfile(outputHandle, inputHandle, &inputOffset, size_t(size - copied));
+        if (count <= 0)
+            break;
+        copied += count;
+    }
+    return copied;
+}
+#endif
+
+bool MappedFile::writeTo(QIODevice *device) const
+{
+    return writeTo(device, 0, m_size);
+}
+
+bool MappedFile::writeTo(QIODevice *device, qint64 offset, qint64 size) const
+{
+    if (!isOpen() || offset < 0 || size < 0 || offset + size > m_size)
+        return false;
+
+    qint64 written = 0;
+
+#if defined (Q_OS_LINUX)
+    QFile *outputFile = qobject_cast<QFile*>(device);
+    if (outputFile && outputFile->handle() != -1 && outputFile->flush()) {
+        const qint64 outputPosition = outputFile->pos();
+        written = copyBetweenFiles(m_file.handle(), offset, outputFile->handle(), size);
+        // The kernel moved the file offset behind QFile's back
+        if (written > 0 && !outputFile->seek(outputPosition + written))
+            return false;
+    }
+#endif
+
+    while (written < size) {
+        const qint64 count = qMin(sliceSize, size - written);
+        if (m_data) {
+            if (device->write(reinterpret_cast<const char*>(m_data) + offset + written, count) != count)
+                return false;
+        } else {
+            if (!m_file.seek(offset + written))
+                return false;
+            const QByteArray slice = m_file.read(count);
+            if (slice.size() != count || device->write(slice) != count)
+                return false;
+        }
+        written += count;
+    }
+
+    return true;
+}
@@ -0,0 +1,49 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include <QFile>
+
+// A read-only file which stays open and mapped into memory, so that its bytes
+// can later be written elsewhere without reading it again by name.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+    qint64 size() const;
+    const uchar *data() const; // nullptr if the file could not be mapped
+    bool writeTo(QIODevice *device) const;
+    bool writeTo(QIODevice *device, qint64 offset, qint64 size) const;
+
+private:
+    Q_DISABLE_COPY(MappedFile)
+
+    mutable QFile m_file;
+    uchar *m_data = nullptr;
+    qint64 m_size = 0;
+};
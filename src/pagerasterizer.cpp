@@ -0,0 +1,94 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "imageloaderinterface.h"
+#include "pagerasterizer.h"
+
+#include <QPainter>
+
+PageRasterizer::PageRasterizer(const ImageLoaderInterface *imageLoader, const QSizeF &sizeCm, qreal dpi)
+    : m_imageLoader(imageLoader)
+    , m_sizeCm(sizeCm)
+    , m_pixelsPerCm(dpi / Types::convertBetweenUnitsOfLength(1, Types::UnitOfLengthInch, Types::UnitOfLengthCentimeter))
+    , m_image(qRound(sizeCm.width() * m_pixelsPerCm), qRound(sizeCm.height() * m_pixelsPerCm), QImage::Format_RGB32)
+{
+    if (m_image.isNull())
+        return;
+    m_image.fill(Qt::white);
+    const int dotsPerMeter = qRound(m_pixelsPerCm * 100);
+    m_image.setDotsPerMeterX(dotsPerMeter);
+    m_image.setDotsPerMeterY(dotsPerMeter);
+}
+
+const QImage &PageRasterizer::image() const
+{
+    return m_image;
+}
+
+void PageRasterizer::drawFilledRect(const QRectF &rect, const QBrush &brush)
+{
+    Q_UNUSED(rect)
+    Q_UNUSED(brush)
+}
+
+QSizeF PageRasterizer::size() const
+{
+    return m_sizeCm;
+}
+
+// Only the visible pixels can be scaled without touching the rest of the
+// image, so without them there is nothing to draw.
+void PageRasterizer::drawImage(const QRectF &rect)
+{
+    Q_UNUSED(rect)
+}
+
+void PageRasterizer::drawImagePart(const QRectF &rect, const QRect &sourceRect)
+{
+    const QSize imageSizePixels = m_imageLoader->sizePixels();
+    if (m_image.isNull() || sourceRect.isEmpty() || imageSizePixels.isEmpty())
+        return;
+
+    // Where the source pixels land on the page. The edges are rounded, so that neighboring pages fit
+    const qreal cmPerSourcePixelX = rect.width() / imageSizePixels.width();
+    const qreal cmPerSourcePixelY = rect.height() / imageSizePixels.height();
+    const QRect targetRect(
+        QPoint(qRound((rect.left() + sourceRect.left() * cmPerSourcePixelX) * m_pixelsPerCm),
+               qRound((rect.top() + sourceRect.top() * cmPerSourcePixelY) * m_pixelsPerCm)),
+        QPoint(qRound((rect.left() + (sourceRect.right() + 1) * cmPerSourcePixelX) * m_pixelsPerCm) - 1,
+               qRound((rect.top() + (sourceRect.bottom() + 1) * cmPerSourcePixelY) * m_pixelsPerCm) - 1)
+    );
+    if (targetRect.isEmpty())
+        return;
+
+    // Only the visible part is scaled, the rest of the image is never touched
+    QPainter painter(&m_image);
+    painter.drawImage(targetRect.topLeft(), m_imageLoader->imageAsRGB(sourceRect, targetRect.size()));
+}
+
+void PageRasterizer::drawOverlayText(const QPointF &position, int flags, int size, const QString &text)
+{
+    Q_UNUSED(position)
+    Q_UNUSED(flags)
+    Q_UNUSED(size)
+    Q_UNUSED(text)
+}
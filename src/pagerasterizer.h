@@ -0,0 +1,53 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include "paintcanvasinterface.h"
+
+#include <QImage>
+
+class ImageLoaderInterface;
+
+// Renders one page of the poster into an image, for printers which want a
+// raster file per sheet instead of a PDF. PosteRazorCore paints the page on
+// it like on the PDFWriter, in cm, with the pixels of the page from its
+// PosterLayout.
+class PageRasterizer: public PaintCanvasInterface
+{
+public:
+    PageRasterizer(const ImageLoaderInterface *imageLoader, const QSizeF &sizeCm, qreal dpi);
+
+    const QImage &image() const; // Null if it was too large to allocate
+
+    void drawFilledRect(const QRectF &rect, const QBrush &brush) override;
+    QSizeF size() const override;
+    void drawImage(const QRectF &rect) override;
+    void drawImagePart(const QRectF &rect, const QRect &sourceRect) override;
+    void drawOverlayText(const QPointF &position, int flags, int size, const QString &text) override;
+
+private:
+    const ImageLoaderInterface *m_imageLoader;
+    QSizeF m_sizeCm;
+    qreal m_pixelsPerCm;
+    QImage m_image;
+};
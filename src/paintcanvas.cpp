@@ -26,11 +26,45 @@
 #include <QPainter>
 #include <QPainterPath>
 #include <QVariant>
+#include <QtConcurrent>
+#include <QtMath>
 
 PaintCanvas::PaintCanvas(QWidget *parent)
     : QWidget(parent)
     , m_state(QLatin1String("image"))
 {
+    // Enough for the page numbers of huge posters in two sizes
+    m_overlayTexts.setMaxCost(1024);
+    m_updateTimer.setSingleShot(true);
+    m_updateTimer.setInterval(16);
+    connect(&m_updateTimer, &QTimer::timeout, this, [this] {
+        if (m_updatePending) {
+            m_updatePending = false;
+            update();
+            m_updateTimer.start();
+        }
+    });
+    connect(&m_imageLevelsWatcher, &QFutureWatcher<QVector<QImage> >::finished, this, [this] {
+        const QVector<QImage> imageLevels = m_imageLevelsWatcher.result();
+        // Only the levels of the current image, a newer one may have been set meanwhile
+        if (!imageLevels.isEmpty() && imageLevels.first().cacheKey() == m_image.cacheKey()) {
+            m_imageLevels = imageLevels;
+            scheduleUpdate();
+        }
+    });
+}
+
+// The first request paints with the next event loop iteration. Further ones
+// within the same frame are merged into one paint at its end. Dragging a
+// spin box thereby paints at most once per frame.
+void PaintCanvas::scheduleUpdate()
+{
+    if (m_updateTimer.isActive()) {
+        m_updatePending = true;
+    } else {
+        update();
+        m_updateTimer.start();
+    }
 }
 
 void PaintCanvas::paintEvent(QPaintEvent *event)
@@ -53,49 +87,103 @@ QSizeF PaintCanvas::size() const
     return QWidget::size();
 }
 
+// The levels are created on a worker thread. Until they are ready, painting
+// scales m_image itself.
 void PaintCanvas::setImage(const QImage &image)
 {
     m_image = image;
-    repaint();
+    m_imageLevels = QVector<QImage>() << m_image;
+    if (!m_image.isNull())
+        m_imageLevelsWatcher.setFuture(QtConcurrent::run(&PaintCanvas::createImageLevels, m_image));
+    scheduleUpdate();
+}
+
+// Each level is scaled from the next bigger one, never from the image loader.
+QVector<QImage> PaintCanvas::createImageLevels(const QImage &image)
+{
+    QVector<QImage> result;
+    result.append(image);
+    while (result.last().width() > 1 && result.last().height() > 1) {
+        const QImage &level = result.last();
+        result.append(level.scaled(level.width() / 2, level.height() / 2,
+                                   Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    }
+    return result;
+}
+
+// The smallest level which is still at least widthPixels wide
+const QImage &PaintCanvas::imageLevel(qreal widthPixels) const
+{
+    for (int level = m_imageLevels.count() - 1; level > 0; level--)
+        if (m_imageLevels.at(level).width() >= widthPixels)
+            return m_imageLevels.at(level);
+    return m_imageLevels.first();
 }
 
 void PaintCanvas::drawImage(const QRectF &rect)
 {
-    const qreal widthResizeFactor = rect.width() / (qreal)m_image.width();
+    const QImage &image = imageLevel(rect.width() * m_qPainter->device()->devicePixelRatioF());
+    const qreal widthResizeFactor = rect.width() / (qreal)image.width();
     m_qPainter->setRenderHint(QPainter::SmoothPixmapTransform, widthResizeFactor < 2.75);
-    m_qPainter->drawImage(rect, m_image);
+    m_qPainter->drawImage(rect, image);
 }
 
 void PaintCanvas::setState(const QString &state)
 {
     m_state = state;
-    repaint();
+    scheduleUpdate();
 }
 
-void PaintCanvas::drawOverlayText(const QPointF &position, int flags, int size, const QString &text)
+PaintCanvas::OverlayText PaintCanvas::renderOverlayText(int size, qreal devicePixelRatio, const QString &text)
 {
-    Q_UNUSED(flags)
-    if (size < 8)
-        return;
     QFont font;
     font.setPixelSize(size);
-    m_qPainter->save();
-    m_qPainter->setOpacity(0.70);
-    const QColor fontColor(0xeeeeee);
     const QFontMetricsF fontMetrics(font);
-    const qreal textWidth = fontMetrics.boundingRect(text).width();
-    const QPointF fontOffset(QPointF(-textWidth / 2, fontMetrics.xHeight() * 1.5));
+    const QRectF textBoundingRect = fontMetrics.boundingRect(text);
+    const QPointF fontOffset(QPointF(-textBoundingRect.width() / 2, fontMetrics.xHeight() * 1.5));
+    const qreal outlineMargin = 2;
+    const QRectF pixmapRect = textBoundingRect.adjusted(-outlineMargin, -outlineMargin, outlineMargin, outlineMargin);
+
+    OverlayText result;
+    result.offset = fontOffset + pixmapRect.topLeft();
+    result.pixmap = QPixmap(qCeil(pixmapRect.width() * devicePixelRatio), qCeil(pixmapRect.height() * devicePixelRatio));
+    result.pixmap.setDevicePixelRatio(devicePixelRatio);
+    result.pixmap.fill(Qt::transparent);
+
+    QPainter painter(&result.pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-pixmapRect.topLeft());
+    const QColor fontColor(0xeeeeee);
     if (size > 35) {
-        m_qPainter->setPen(0x656565);
-        m_qPainter->setBrush(fontColor);
+        painter.setPen(0x656565);
+        painter.setBrush(fontColor);
         QPainterPath textPath;
-        textPath.addText(position + fontOffset, font, text);
-        m_qPainter->drawPath(textPath);
+        textPath.addText(QPointF(), font, text);
+        painter.drawPath(textPath);
     } else {
-        m_qPainter->setPen(fontColor);
-        m_qPainter->setRenderHint(QPainter::TextAntialiasing);
-        m_qPainter->setFont(font);
-        m_qPainter->drawText(position + fontOffset, text);
+        painter.setPen(fontColor);
+        painter.setRenderHint(QPainter::TextAntialiasing);
+        painter.setFont(font);
+        painter.drawText(QPointF(), text);
+    }
+
+    return result;
+}
+
+void PaintCanvas::drawOverlayText(const QPointF &position, int flags, int size, const QString &text)
+{
+    Q_UNUSED(flags)
+    if (size < 8)
+        return;
+    const qreal devicePixelRatio = m_qPainter->device()->devicePixelRatioF();
+    const QString key = QString::fromLatin1("%1 %2 ").arg(size).arg(devicePixelRatio) + text;
+    OverlayText *overlayText = m_overlayTexts.object(key);
+    if (!overlayText) {
+        overlayText = new OverlayText(renderOverlayText(size, devicePixelRatio, text));
+        m_overlayTexts.insert(key, overlayText);
     }
+    m_qPainter->save();
+    m_qPainter->setOpacity(0.70);
+    m_qPainter->drawPixmap(position + overlayText->offset, overlayText->pixmap);
     m_qPainter->restore();
 }
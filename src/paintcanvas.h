@@ -22,6 +22,11 @@
 
 #pragma once
 
+#include <QCache>
+#include <QFutureWatcher>
+#include <QPixmap>
+#include <QTimer>
+#include <QVector>
 #include <QWidget>
 #include "paintcanvasinterface.h"
 
@@ -35,9 +40,23 @@ class PaintCanvas: public QWidget, public PaintCanvasInterface
     Q_OBJECT
 
 private:
+    // A label, rendered once and then only blitted
+    struct OverlayText {
+        QPixmap pixmap;
+        QPointF offset; // Of the pixmap, relative to the position of the label
+    };
+
     QImage m_image;
+    QVector<QImage> m_imageLevels; // m_image, then each level halved. Only m_image until the others are ready
+    QFutureWatcher<QVector<QImage> > m_imageLevelsWatcher;
     QPainter *m_qPainter = nullptr;
     QString m_state;
+    QTimer m_updateTimer; // Runs for one frame after each paint request
+    bool m_updatePending = false;
+    QCache<QString, OverlayText> m_overlayTexts; // By pixel size, device pixel ratio and text
+
+    static OverlayText renderOverlayText(int size, qreal devicePixelRatio, const QString &text);
+    static QVector<QImage> createImageLevels(const QImage &image);
 
 public:
     PaintCanvas(QWidget *parent);
@@ -46,7 +65,9 @@ public:
     void drawFilledRect(const QRectF &rect, const QBrush &brush) override;
     QSizeF size() const override;
     void drawImage(const QRectF &rect) override;
+    const QImage &imageLevel(qreal widthPixels) const;
     void setState(const QString &state);
+    void scheduleUpdate();
     void drawOverlayText(const QPointF &position, int flags, int size, const QString &text) override;
 
 public slots:
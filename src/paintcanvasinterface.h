@@ -34,5 +34,8 @@ public:
     virtual void drawFilledRect(const QRectF &rect, const QBrush &brush) = 0;
     virtual QSizeF size() const = 0;
     virtual void drawImage(const QRectF &rect) = 0;
+    // Like drawImage(), if the canvas only shows the pixels sourceRect of
+    // the image. Canvases which can crop the image draw only those.
+    virtual void drawImagePart(const QRectF &rect, const QRect &sourceRect) { Q_UNUSED(sourceRect) drawImage(rect); }
     virtual void drawOverlayText(const QPointF &position, int flags, int size, const QString &text) = 0;
 };
@@ -0,0 +1,350 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "passthroughimage.h"
+
+#include <QHash>
+#include <QRgb>
+#include <QtEndian>
+
+#include <cstring>
+
+static QString indexedColorSpace(const QVector<QRgb> &colorTable)
+{
+    // -1, because PDF wants the highest index, not the number of entries
+    QString colorSpace = QString::fromLatin1("[/Indexed /DeviceRGB %1 <").arg(colorTable.count() - 1);
+    for (const QRgb &paletteEntry : colorTable)
+        colorSpace.append(QString::fromLatin1("%1%2%3")
+            .arg(qRed(paletteEntry), 2, 16, QLatin1Char('0'))
+            .arg(qGreen(paletteEntry), 2, 16, QLatin1Char('0'))
+            .arg(qBlue(paletteEntry), 2, 16, QLatin1Char('0')));
+    colorSpace.append(QLatin1String(">]"));
+    return colorSpace;
+}
+
+static QString predictorParameters(int predictor, int colors, int bitsPerComponent, int columns)
+{
+    return QString::fromLatin1("<</Predictor %1 /Colors %2 /BitsPerComponent %3 /Columns %4>>")
+        .arg(predictor).arg(colors).arg(bitsPerComponent).arg(columns);
+}
+
+bool PassthroughImage::open(const QString &fileName)
+{
+    close();
+    if (!m_file.open(fileName) || !m_file.data() || !(readPng() || readTiff())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PassthroughImage::close()
+{
+    m_file.close();
+    m_sizePixels = QSize();
+    m_bitsPerComponent = 0;
+    m_colorSpace.clear();
+    m_filter.clear();
+    m_decodeParameters.clear();
+    m_decodeArray.clear();
+    m_segments.clear();
+}
+
+bool PassthroughImage::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QSize PassthroughImage::sizePixels() const
+{
+    return m_sizePixels;
+}
+
+int PassthroughImage::bitsPerComponent() const
+{
+    return m_bitsPerComponent;
+}
+
+QString PassthroughImage::colorSpace() const
+{
+    return m_colorSpace;
+}
+
+QString PassthroughImage::filter() const
+{
+    return m_filter;
+}
+
+QString PassthroughImage::decodeParameters() const
+{
+    return m_decodeParameters;
+}
+
+QString PassthroughImage::decodeArray() const
+{
+    return m_decodeArray;
+}
+
+qint64 PassthroughImage::dataSize() const
+{
+    qint64 size = 0;
+    for (const auto &segment : m_segments)
+        size += segment.second;
+    return size;
+}
+
+bool PassthroughImage::writeData(QIODevice *device) const
+{
+    for (const auto &segment : m_segments)
+        if (!m_file.writeTo(device, segment.first, segment.second))
+            return false;
+    return true;
+}
+
+// The concatenated IDAT chunks are a zlib stream with PNG predictors, which
+// is exactly what FlateDecode with /Predictor 15 expects. Interlaced images
+// and images with alpha channel or transparent color do not fit into PDF.
+bool PassthroughImage::readPng()
+{
+    const uchar *data = m_file.data();
+    const qint64 size = m_file.size();
+    static const uchar signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (size < 8 + 25 || memcmp(data, signature, sizeof signature) != 0)
+        return false;
+
+    int width = 0;
+    int height = 0;
+    int bitDepth = 0;
+    int colorType = -1;
+    QVector<QRgb> palette;
+    QVector<QPair<qint64, qint64> > segments;
+
+    for (qint64 offset = 8; offset + 12 <= size; ) {
+        const qint64 chunkSize = qFromBigEndian<quint32>(data + offset);
+        const QByteArray type = QByteArray::fromRawData(reinterpret_cast<const char*>(data) + offset + 4, 4);
+        const qint64 chunkDataOffset = offset + 8;
+        if (chunkDataOffset + chunkSize + 4 > size)
+            return false;
+        const uchar *chunkData = data + chunkDataOffset;
+
+        if (type == "IHDR") {
+            if (chunkSize != 13)
+                return false;
+            width = int(qFromBigEndian<quint32>(chunkData));
+            height = int(qFromBigEndian<quint32>(chunkData + 4));
+            bitDepth = chunkData[8];
+            colorType = chunkData[9];
+            const int interlaceMethod = chunkData[12];
+            if (chunkData[10] != 0 || chunkData[11] != 0 || interlaceMethod != 0)
+                return false;
+        } else if (type == "PLTE") {
+            for (qint64 entry = 0; entry + 3 <= chunkSize; entry += 3)
+                palette.append(qRgb(chunkData[entry], chunkData[entry + 1], chunkData[entry + 2]));
+        } else if (type == "tRNS") {
+            return false;
+        } else if (type == "IDAT") {
+            segments.append(qMakePair(chunkDataOffset, chunkSize));
+        } else if (type == "IEND") {
+            break;
+        }
+        offset = chunkDataOffset + chunkSize + 4; // + CRC
+    }
+
+    if (width <= 0 || height <= 0 || segments.isEmpty() || bitDepth > 8)
+        return false;
+
+    int colors = 1;
+    switch (colorType) {
+    case 0:
+        m_colorSpace = QLatin1String("/DeviceGray");
+        break;
+    case 2:
+        colors = 3;
+        m_colorSpace = QLatin1String("/DeviceRGB");
+        break;
+    case 3:
+        if (palette.isEmpty())
+            return false;
+        m_colorSpace = indexedColorSpace(palette);
+        break;
+    default:
+        return false; // Grey or RGB with alpha channel
+    }
+
+    m_sizePixels = QSize(width, height);
+    m_bitsPerComponent = bitDepth;
+    m_filter = QLatin1String("/FlateDecode");
+    m_decodeParameters = predictorParameters(15, colors, bitDepth, width);
+    m_segments = segments;
+    return true;
+}
+
+// A single strip of Deflate, LZW or CCITT Group 4 data is a complete PDF
+// stream. The strips of multi-strip images restart their compression, so
+// those cannot be concatenated into one stream.
+bool PassthroughImage::readTiff()
+{
+    const uchar *data = m_file.data();
+    const qint64 size = m_file.size();
+    if (size < 8)
+        return false;
+    const bool bigEndian = data[0] == 'M' && data[1] == 'M';
+    if (!bigEndian && !(data[0] == 'I' && data[1] == 'I'))
+        return false;
+    const auto read16 = [data, bigEndian] (qint64 offset) -> quint32 {
+        return bigEndian ? qFromBigEndian<quint16>(data + offset) : qFromLittleEndian<quint16>(data + offset);
+    };
+    const auto read32 = [data, bigEndian] (qint64 offset) -> quint32 {
+        return bigEndian ? qFromBigEndian<quint32>(data + offset) : qFromLittleEndian<quint32>(data + offset);
+    };
+    if (read16(2) != 42)
+        return false;
+
+    const qint64 directoryOffset = read32(4);
+    if (directoryOffset + 2 > size)
+        return false;
+    const int entriesCount = int(read16(directoryOffset));
+    if (directoryOffset + 2 + entriesCount * 12 > size)
+        return false;
+
+    // The values of BYTE, SHORT and LONG tags
+    QHash<int, QVector<quint32> > tags;
+    for (int entry = 0; entry < entriesCount; entry++) {
+        const qint64 entryOffset = directoryOffset + 2 + entry * 12;
+        const int tag = int(read16(entryOffset));
+        const int type = int(read16(entryOffset + 2));
+        const qint64 count = read32(entryOffset + 4);
+        const int valueSize = type == 1 ? 1 : type == 3 ? 2 : type == 4 ? 4 : 0;
+        if (valueSize == 0 || count == 0)
+            continue;
+        const qint64 valuesOffset = count * valueSize <= 4 ? entryOffset + 8 : qint64(read32(entryOffset + 8));
+        if (count > size || valuesOffset + count * valueSize > size)
+            return false;
+        QVector<quint32> values(int(count));
+        for (int index = 0; index < values.count(); index++) {
+            const qint64 valueOffset = valuesOffset + index * valueSize;
+            values[index] = valueSize == 1 ? data[valueOffset] : valueSize == 2 ? read16(valueOffset) : read32(valueOffset);
+        }
+        tags.insert(tag, values);
+    }
+    const auto tagValue = [&tags] (int tag, quint32 defaultValue) -> quint32 {
+        const QVector<quint32> values = tags.value(tag);
+        return values.isEmpty() ? defaultValue : values.first();
+    };
+
+    const int width = int(tagValue(256, 0));
+    const int height = int(tagValue(257, 0));
+    const int compression = int(tagValue(259, 1));
+    const int photometric = int(tagValue(262, 0xffff));
+    const int samplesPerPixel = int(tagValue(277, 1));
+    const int planarConfiguration = int(tagValue(284, 1));
+    const int fillOrder = int(tagValue(266, 1));
+    const int predictor = int(tagValue(317, 1));
+    const QVector<quint32> bitsPerSample = tags.value(258, QVector<quint32>() << 1);
+    const QVector<quint32> stripOffsets = tags.value(273);
+    const QVector<quint32> stripByteCounts = tags.value(279);
+
+    if (width <= 0 || height <= 0 || planarConfiguration != 1 || fillOrder != 1
+            || tags.contains(322) // Tiled
+            || tags.contains(338) // ExtraSamples, usually alpha
+            || stripOffsets.count() != 1 || stripByteCounts.count() != 1
+            || qint64(stripOffsets.first()) + stripByteCounts.first() > size)
+        return false;
+    const int bitDepth = int(bitsPerSample.first());
+    if (bitsPerSample.count() != samplesPerPixel || bitsPerSample.count(bitsPerSample.first()) != bitsPerSample.count()
+            || (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8))
+        return false;
+
+    switch (photometric) {
+    case 0: // WhiteIsZero
+    case 1: // BlackIsZero
+        if (samplesPerPixel != 1)
+            return false;
+        m_colorSpace = QLatin1String("/DeviceGray");
+        break;
+    case 2:
+        if (samplesPerPixel != 3)
+            return false;
+        m_colorSpace = QLatin1String("/DeviceRGB");
+        break;
+    case 3: {
+        const QVector<quint32> colorMap = tags.value(320);
+        const int colorsCount = 1 << bitDepth;
+        if (samplesPerPixel != 1 || colorMap.count() != colorsCount * 3)
+            return false;
+        QVector<QRgb> palette;
+        for (int index = 0; index < colorsCount; index++)
+            palette.append(qRgb(colorMap.at(index) >> 8, colorMap.at(colorsCount + index) >> 8,
+                                colorMap.at(colorsCount * 2 + index) >> 8));
+        m_colorSpace = indexedColorSpace(palette);
+        break;
+    }
+    case 5:
+        if (samplesPerPixel != 4 || tagValue(332, 1) != 1) // InkSet: CMYK
+            return false;
+        m_colorSpace = QLatin1String("/DeviceCMYK");
+        break;
+    default:
+        return false;
+    }
+
+    const qint64 stripOffset = stripOffsets.first();
+    const qint64 stripSize = stripByteCounts.first();
+    switch (compression) {
+    case 4: // CCITT Group 4
+        if (bitDepth != 1 || samplesPerPixel != 1 || photometric > 1
+                || (tagValue(293, 0) & 2)) // T6Options: uncompressed mode
+            return false;
+        m_filter = QLatin1String("/CCITTFaxDecode");
+        // The codes describe white and black runs. PDF decodes black to 0,
+        // TIFF readers show the inverse of that for BlackIsZero.
+        m_decodeParameters = QString::fromLatin1("<</K -1 /Columns %1 /Rows %2%3>>")
+            .arg(width).arg(height)
+            .arg(photometric == 1 ? QLatin1String(" /BlackIs1 true") : QLatin1String(""));
+        break;
+    case 5: // LZW
+        // Old-style LZW, from before TIFF 6, has its codes in reversed bit order
+        if (stripSize < 2 || (data[stripOffset] == 0 && (data[stripOffset + 1] & 1)))
+            return false;
+        m_filter = QLatin1String("/LZWDecode");
+        break;
+    case 8: // Adobe Deflate
+    case 32946: // Deflate
+        m_filter = QLatin1String("/FlateDecode");
+        break;
+    default:
+        return false;
+    }
+    if (compression != 4) {
+        if (predictor == 2)
+            m_decodeParameters = predictorParameters(2, samplesPerPixel, bitDepth, width);
+        else if (predictor != 1)
+            return false;
+        if (photometric == 0)
+            m_decodeArray = QLatin1String("[1 0]");
+    }
+
+    m_sizePixels = QSize(width, height);
+    m_bitsPerComponent = bitDepth;
+    m_segments.append(qMakePair(stripOffset, stripSize));
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include "mappedfile.h"
+
+#include <QPair>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+// The compressed pixel data of a PNG or TIFF file, in case a PDF reader can
+// decode it as it is. Such images are embedded without decoding and
+// compressing them again, like JPEG files.
+class PassthroughImage
+{
+public:
+    // Returns false, and stays closed, if the file is none of the supported cases
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    QSize sizePixels() const;
+    int bitsPerComponent() const;
+    QString colorSpace() const;
+    QString filter() const;
+    QString decodeParameters() const; // Empty if the filter needs none
+    QString decodeArray() const; // Empty for the default decoding
+    qint64 dataSize() const;
+    bool writeData(QIODevice *device) const;
+
+private:
+    bool readPng();
+    bool readTiff();
+
+    MappedFile m_file;
+    QSize m_sizePixels;
+    int m_bitsPerComponent = 0;
+    QString m_colorSpace;
+    QString m_filter;
+    QString m_decodeParameters;
+    QString m_decodeArray;
+    QVector<QPair<qint64, qint64> > m_segments; // Offsets and sizes in the file, which form the stream
+};
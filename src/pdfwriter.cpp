@@ -20,8 +20,12 @@
     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 */
 
+#include "flatestream.h"
+#include "mappedfile.h"
 #include "paintcanvasinterface.h"
+#include "passthroughimage.h"
 #include "pdfwriter.h"
+#include "pixelkernels.h"
 
 #include <QBrush>
 #include <QDateTime>
@@ -29,9 +33,13 @@
 #include <QFileInfo>
 #include <QRectF>
 
+#include <cstring>
+
 #define LINEFEED "\x0A"
 
 const int valuePrecision = 4;
+const int imageTileSize = 512; // Edge length in pixels of the PdfImageModeTiled tiles
+const int imageBandHeight = 64; // Rows read at once, unless tiles need more
 
 #define COMPRESSEDPDF
 
@@ -40,19 +48,133 @@ static qreal cm2Pt(qreal cm)
     return Types::convertBetweenUnitsOfLength(cm, Types::UnitOfLengthCentimeter, Types::UnitOfLengthPoints);
 }
 
+// Turns rows into what FlateDecode with /Predictor 15 expects: the PNG filter
+// type byte followed by the filtered row.
+class PngRowFilter
+{
+public:
+    PngRowFilter(Types::PngPredictors predictor, int bytesCount, int bytesPerPixel)
+        : m_predictor(predictor)
+        , m_bytesCount(bytesCount)
+        , m_bytesPerPixel(bytesPerPixel)
+        , m_previousRow(bytesCount, 0)
+        , m_filteredRow(bytesCount + 1, 0)
+        , m_candidateRow(predictor == Types::PngPredictorAdaptive ? bytesCount : 0, 0)
+    {
+    }
+
+    const QByteArray &filter(const char *row)
+    {
+        const uchar *current = reinterpret_cast<const uchar*>(row);
+        const uchar *previous = reinterpret_cast<const uchar*>(m_previousRow.constData());
+        uchar *filtered = reinterpret_cast<uchar*>(m_filteredRow.data());
+        switch (m_predictor) {
+        case Types::PngPredictorSub:
+            filtered[0] = 1;
+            PixelKernels::pngFilterSub(current, filtered + 1, m_bytesCount, m_bytesPerPixel);
+            break;
+        case Types::PngPredictorUp:
+            filtered[0] = 2;
+            PixelKernels::pngFilterUp(current, previous, filtered + 1, m_bytesCount);
+            break;
+        case Types::PngPredictorPaeth:
+            filtered[0] = 4;
+            PixelKernels::pngFilterPaeth(current, previous, filtered + 1, m_bytesCount, m_bytesPerPixel);
+            break;
+        default: {
+            // The heuristic of libpng: the smallest sum of signed magnitudes
+            uchar *candidate = reinterpret_cast<uchar*>(m_candidateRow.data());
+            filtered[0] = 0;
+            memcpy(filtered + 1, current, size_t(m_bytesCount));
+            quint64 bestCost = PixelKernels::pngFilterCost(current, m_bytesCount);
+            for (const uchar type : {uchar(1), uchar(2), uchar(4)}) {
+                if (type == 1)
+                    PixelKernels::pngFilterSub(current, candidate, m_bytesCount, m_bytesPerPixel);
+                else if (type == 2)
+                    PixelKernels::pngFilterUp(current, previous, candidate, m_bytesCount);
+                else
+                    PixelKernels::pngFilterPaeth(current, previous, candidate, m_bytesCount, m_bytesPerPixel);
+                const quint64 cost = PixelKernels::pngFilterCost(candidate, m_bytesCount);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    filtered[0] = type;
+                    memcpy(filtered + 1, candidate, size_t(m_bytesCount));
+                }
+            }
+        }
+        }
+        memcpy(m_previousRow.data(), row, size_t(m_bytesCount));
+        return m_filteredRow;
+    }
+
+private:
+    const Types::PngPredictors m_predictor;
+    const int m_bytesCount;
+    const int m_bytesPerPixel;
+    QByteArray m_previousRow;
+    QByteArray m_filteredRow;
+    QByteArray m_candidateRow;
+};
+
 PDFWriter::PDFWriter(QObject *parent)
     : QObject(parent)
 {
+    m_compressionThreadPool.setMaxThreadCount(m_compressionThreadsCount);
 }
 
-void PDFWriter::addOffsetToXref()
+void PDFWriter::setCompressionLevel(int level)
+{
+    m_compressionLevel = level;
+}
+
+void PDFWriter::setCompressionThreadsCount(int count)
+{
+    m_compressionThreadsCount = qMax(1, count);
+    m_compressionThreadPool.setMaxThreadCount(m_compressionThreadsCount);
+}
+
+void PDFWriter::setImageMode(Types::PdfImageModes mode)
+{
+    m_imageMode = mode;
+}
+
+void PDFWriter::setPngPredictor(Types::PngPredictors predictor)
+{
+    m_pngPredictor = predictor;
+}
+
+void PDFWriter::setDeflateBackend(Types::DeflateBackends backend)
+{
+    m_deflateBackend = backend;
+}
+
+void PDFWriter::setProgressHandler(const Types::SavingProgressHandler &handler)
+{
+    m_progressHandler = handler;
+}
+
+bool PDFWriter::reportProgress(Types::SavingStages stage, qint64 done, qint64 total)
+{
+    if (!m_canceled && m_progressHandler && !m_progressHandler(stage, done, total))
+        m_canceled = true;
+    return !m_canceled;
+}
+
+int PDFWriter::reserveObjectID()
+{
+    m_objectOffsets.append(0);
+    return ++m_pdfObjectCount;
+}
+
+void PDFWriter::startObject(int objectID)
 {
-    m_pdfObjectCount++;
     m_outStream.flush();
-    m_xref.append(
-        QString::fromLatin1("%1 %2 n " LINEFEED)
-        .arg((int)m_outStream.device()->size(), 10, 10, QLatin1Char('0'))
-        .arg(0, 5, 10, QLatin1Char('0')));
+    m_objectOffsets[objectID - 1] = m_outStream.device()->size();
+}
+
+void PDFWriter::addOffsetToXref()
+{
+    startObject(reserveObjectID());
 }
 
 int PDFWriter::addImageResourcesAndXObject()
@@ -82,16 +204,18 @@ int PDFWriter::addImageResourcesAndXObject()
     return err;
 }
 
-int PDFWriter::saveJpegImage(const QString &jpegFileName, const QSize &sizePixels, Types::ColorTypes colorType)
+int PDFWriter::saveJpegImage(const MappedFile &jpegFile, const QSize &sizePixels, Types::ColorTypes colorType)
 {
     int err = 0;
 
+    // The DCT data can only be embedded as a whole
+    m_imageMode = Types::PdfImageModeShared;
+
     err = addImageResourcesAndXObject();
-    QFile jpegFile(jpegFileName);
-    if (!jpegFile.open(QIODevice::ReadOnly))
+    if (!jpegFile.isOpen())
         return 2;
 
-    const int jpegFileSize = jpegFile.size();
+    const qint64 jpegFileSize = jpegFile.size();
     if (jpegFileSize == 0)
         return 3;
 
@@ -127,8 +251,11 @@ int PDFWriter::saveJpegImage(const QString &jpegFileName, const QSize &sizePixel
         .arg(decodeArray);
 
     m_outStream.flush();
-    while (!jpegFile.atEnd())
-        m_outStream.device()->write(jpegFile.read(200000));
+    if (!reportProgress(Types::SavingStageCompression, 0, jpegFileSize))
+        return Types::savingCanceledError;
+    if (!jpegFile.writeTo(m_outStream.device()))
+        return 4;
+    reportProgress(Types::SavingStageCompression, jpegFileSize, jpegFileSize);
 
     m_outStream <<
         LINEFEED "endstream" LINEFEED
@@ -137,77 +264,23 @@ int PDFWriter::saveJpegImage(const QString &jpegFileName, const QSize &sizePixel
     return err;
 }
 
-int PDFWriter::saveImage(const QByteArray &imageData, const QSize &sizePixels, int bitPerPixel, Types::ColorTypes colorType, const QVector<QRgb> &colorTable)
+int PDFWriter::savePassthroughImage(const PassthroughImage &image)
 {
     int err = 0;
-    err = addImageResourcesAndXObject();
-    const bool hasSoftMask = colorType == Types::ColorTypeRGBA;
-    const Types::ColorTypes actualColorType = hasSoftMask ? Types::ColorTypeRGB : colorType;
-    const int actualBitsPerPixel = hasSoftMask ? (bitPerPixel / 4) * 3 : bitPerPixel;
 
-    QString sMaskString;
-    QByteArray softMask;
-    QByteArray actualImageData;
-    // Extract the alpha channel into "softMask"
-    if (hasSoftMask) {
-        const unsigned int pixelCount = sizePixels.height() * sizePixels.width();
-        actualImageData.resize(imageData.size() - pixelCount);
-        softMask.resize(pixelCount);
-        const char *source = imageData.data();
-        char *destinationRgb = actualImageData.data();
-        char *destinationAlpha = softMask.data();
-        for (unsigned int pixel = 0; pixel < pixelCount; pixel++){
-            *destinationAlpha++ = *source++;
-            *destinationRgb++ = *source++;
-            *destinationRgb++ = *source++;
-            *destinationRgb++ = *source++;
-        }
-        sMaskString = QString::fromLatin1("/SMask %1 0 R" LINEFEED).arg(m_pdfObjectCount + 2);
-    } else {
-        actualImageData = imageData;
-    }
+    // Like the DCT data, the compressed data can only be embedded as a whole
+    m_imageMode = Types::PdfImageModeShared;
 
-#ifdef COMPRESSEDPDF
-    const int compressedByteArrayPrependedBytes = 4;
-    const int compressedByteArrayAppendedBytes = 4;
-    const QByteArray imageDataCompressed = qCompress(actualImageData, 9);
-    // qCompress adds 4 extra bytes before and after the compressed
-    // results. In the prepended bytes, we have the original size
-    // of the uncompressed data. We need to chop these bytes off
-    // from both ends when inserting into the PDF document...
-#endif
+    err = addImageResourcesAndXObject();
+    if (!image.isOpen())
+        return 2;
 
-    QString colorSpaceString;
-    switch (actualColorType) {
-    case Types::ColorTypeRGB:
-        colorSpaceString = QLatin1String("/DeviceRGB");
-        break;
-    case Types::ColorTypeGreyscale:
-        colorSpaceString = QLatin1String("/DeviceGray");
-        break;
-    case Types::ColorTypeCMYK:
-        colorSpaceString = QLatin1String("/DeviceCMYK");
-        break;
-    default:
-        colorSpaceString = QString::fromLatin1("[/Indexed /DeviceRGB %1 <").arg(colorTable.count()-1); // -1, because PDF wants the highest index, not the number of entries
-        foreach (const QRgb &paletteEntry, colorTable) {
-            QString rgbHex = QString::fromLatin1("%1%2%3")
-                .arg(qRed(paletteEntry), 2, 16, QLatin1Char('0'))
-                .arg(qGreen(paletteEntry), 2, 16, QLatin1Char('0'))
-                .arg(qBlue(paletteEntry), 2, 16, QLatin1Char('0'));
-            colorSpaceString.append(rgbHex);
-        }
-        colorSpaceString.append(QLatin1String(">]"));
-    }
+    const QString decodeParameters = image.decodeParameters().isEmpty() ? QString()
+        : QString::fromLatin1("/DecodeParms %1" LINEFEED).arg(image.decodeParameters());
+    const QString decodeArray = image.decodeArray().isEmpty() ? QString()
+        : QString::fromLatin1("/Decode %1" LINEFEED).arg(image.decodeArray());
 
-    const int bitsPerComponent =
-        actualColorType == Types::ColorTypePalette ? actualBitsPerPixel
-        : actualColorType == Types::ColorTypeMonochrome ? actualBitsPerPixel
-        : actualColorType == Types::ColorTypeGreyscale ? actualBitsPerPixel
-        : actualColorType == Types::ColorTypeCMYK ? (actualBitsPerPixel / 4)
-        : (actualBitsPerPixel / 3);
     addOffsetToXref();
-    m_objectImageID = m_pdfObjectCount;
     m_outStream << QString::fromLatin1(
         LINEFEED "%1 0 obj" LINEFEED
         "<</ColorSpace %2" LINEFEED
@@ -216,79 +289,297 @@ int PDFWriter::saveImage(const QByteArray &imageData, const QSize &sizePixels, i
         "/Width %4" LINEFEED
         "/Type /XObject" LINEFEED
         "/Height %5" LINEFEED
-#ifdef COMPRESSEDPDF
-        "/Filter /FlateDecode" LINEFEED
-#endif
         "/BitsPerComponent %6" LINEFEED
-        "%7"
+        "/Filter %7" LINEFEED
+        "%8"
+        "%9"
         ">>" LINEFEED
         "stream" LINEFEED)
         .arg(m_pdfObjectCount)
-        .arg(colorSpaceString)
-#ifdef COMPRESSEDPDF
-        .arg(imageDataCompressed.size() - compressedByteArrayPrependedBytes - compressedByteArrayAppendedBytes)
-#else
-        .arg(imageData.size())
-#endif
-        .arg(sizePixels.width())
-        .arg(sizePixels.height())
-        .arg(bitsPerComponent)
-        .arg(sMaskString);
+        .arg(image.colorSpace())
+        .arg(image.dataSize())
+        .arg(image.sizePixels().width())
+        .arg(image.sizePixels().height())
+        .arg(image.bitsPerComponent())
+        .arg(image.filter())
+        .arg(decodeParameters)
+        .arg(decodeArray);
+
+    m_outStream.flush();
+    if (!reportProgress(Types::SavingStageCompression, 0, image.dataSize()))
+        return Types::savingCanceledError;
+    if (!image.writeData(m_outStream.device()))
+        return 4;
+    reportProgress(Types::SavingStageCompression, image.dataSize(), image.dataSize());
 
-    m_outStream.flush(); // Important to flush stream before writing to device
-    m_outStream.device()->write(
-#ifdef COMPRESSEDPDF
-        imageDataCompressed.constData() + compressedByteArrayPrependedBytes,
-        imageDataCompressed.size() - compressedByteArrayPrependedBytes - compressedByteArrayAppendedBytes
-#else
-        imageData.constData(), imageData.size()
-#endif
-    );
     m_outStream <<
         LINEFEED "endstream" LINEFEED
         "endobj";
 
-    if (hasSoftMask) {
+    return err;
+}
+
+QString PDFWriter::decodeParameters(int colors, int bitsPerComponent, int columns) const
+{
 #ifdef COMPRESSEDPDF
-        const QByteArray softMaskDataCompressed = qCompress(softMask, 9);
+    if (m_pngPredictor != Types::PngPredictorNone)
+        return QString::fromLatin1("/DecodeParms <</Predictor 15 /Colors %1 /BitsPerComponent %2 /Columns %3>>" LINEFEED)
+            .arg(colors)
+            .arg(bitsPerComponent)
+            .arg(columns);
+#else
+    Q_UNUSED(colors)
+    Q_UNUSED(bitsPerComponent)
+    Q_UNUSED(columns)
 #endif
-        addOffsetToXref();
-        m_outStream << QString::fromLatin1(
-            LINEFEED "%1 0 obj" LINEFEED
-            "<</ColorSpace /DeviceGray" LINEFEED
-            "/Subtype /Image" LINEFEED
-            "/Length %2" LINEFEED
-            "/Width %3" LINEFEED
-            "/Type /XObject" LINEFEED
-            "/Height %4" LINEFEED
+    return QString();
+}
+
+int PDFWriter::saveImageStream(const QString &dictionary, int rowsCount, int bytesPerRow, int bytesPerPixel, const std::function<void(int row, char *destination)> &fillRow)
+{
+    // The compressed size is only known once the last row is written, so
+    // /Length refers to an indirect object which directly follows the stream.
+    addOffsetToXref();
+    m_outStream << QString::fromLatin1(
+        LINEFEED "%1 0 obj" LINEFEED
+        "<<%2"
 #ifdef COMPRESSEDPDF
-            "/Filter /FlateDecode" LINEFEED
+        "/Filter /FlateDecode" LINEFEED
 #endif
-            "/BitsPerComponent 8" LINEFEED
-            "/Decode [ 0 1 ]" LINEFEED
-            ">>" LINEFEED
-            "stream" LINEFEED)
-            .arg(m_pdfObjectCount)
+        "/Length %3 0 R" LINEFEED
+        ">>" LINEFEED
+        "stream" LINEFEED)
+        .arg(m_pdfObjectCount)
+        .arg(dictionary)
+        .arg(m_pdfObjectCount + 1);
+
+    m_outStream.flush(); // Important to flush stream before writing to device
+    QIODevice *device = m_outStream.device();
+    QByteArray row(bytesPerRow, 0);
+    qint64 streamLength = 0;
 #ifdef COMPRESSEDPDF
-            .arg(softMaskDataCompressed.size() - compressedByteArrayPrependedBytes - compressedByteArrayAppendedBytes)
+    FlateStream flateStream(device, m_compressionLevel, &m_compressionThreadPool, m_deflateBackend);
+    PngRowFilter rowFilter(m_pngPredictor, bytesPerRow, bytesPerPixel);
 #else
-            .arg(softMask.size())
+    Q_UNUSED(bytesPerPixel)
 #endif
-            .arg(sizePixels.width())
-            .arg(sizePixels.height());
-        m_outStream.flush(); // Important to flush stream before writing to device
-        m_outStream.device()->write(
+    for (int rowIndex = 0; rowIndex < rowsCount; rowIndex++) {
+        fillRow(rowIndex, row.data());
 #ifdef COMPRESSEDPDF
-            softMaskDataCompressed.constData() + compressedByteArrayPrependedBytes,
-            softMaskDataCompressed.size() - compressedByteArrayPrependedBytes - compressedByteArrayAppendedBytes
+        if (m_pngPredictor != Types::PngPredictorNone) {
+            const QByteArray &filteredRow = rowFilter.filter(row.constData());
+            if (!flateStream.write(filteredRow.constData(), filteredRow.size()))
+                return 4;
+        } else if (!flateStream.write(row.constData(), bytesPerRow)) {
+            return 4;
+        }
 #else
-            softMask.constData(), softMask.size()
+        if (device->write(row) != bytesPerRow)
+            return 4;
+        streamLength += bytesPerRow;
+#endif
+        // Also catches a cancellation while fillRow() read the image
+        m_compressedBytes += bytesPerRow;
+        if (!reportProgress(Types::SavingStageCompression, m_compressedBytes, m_compressionTotalBytes))
+            return Types::savingCanceledError;
+    }
+#ifdef COMPRESSEDPDF
+    if (!flateStream.finish())
+        return 4;
+    streamLength = flateStream.bytesWritten();
 #endif
+
+    m_outStream <<
+        LINEFEED "endstream" LINEFEED
+        "endobj";
+
+    addOffsetToXref();
+    m_outStream << QString::fromLatin1(
+        LINEFEED "%1 0 obj" LINEFEED
+        "%2" LINEFEED
+        "endobj")
+        .arg(m_pdfObjectCount)
+        .arg(streamLength);
+
+    return 0;
+}
+
+int PDFWriter::saveImage(const RowsReader &readRows, const QSize &sizePixels, int bitPerPixel, Types::ColorTypes colorType, const QVector<QRgb> &colorTable)
+{
+    m_readRows = readRows;
+    m_imageSizePixels = sizePixels;
+    m_imageBitsPerPixel = bitPerPixel;
+    m_imageColorType = colorType;
+    m_imageBytesPerLine = (qint64(sizePixels.width()) * bitPerPixel + 7) / 8;
+    // A band holds a whole row of tiles
+    m_bandHeight = m_imageMode == Types::PdfImageModeTiled ? imageTileSize : imageBandHeight;
+    m_bandFirstRow = 0;
+    m_bandRowsCount = 0;
+    m_compressedBytes = 0;
+    // The alpha channel is split off into the soft mask before compressing
+    m_compressionTotalBytes = m_imageMode == Types::PdfImageModePerPage ? 0
+        : (qint64(sizePixels.width()) * (colorType == Types::ColorTypeRGBA ? 24 + 8 : bitPerPixel) + 7) / 8 * sizePixels.height();
+
+    switch (colorType == Types::ColorTypeRGBA ? Types::ColorTypeRGB : colorType) {
+    case Types::ColorTypeRGB:
+        m_imageColorSpace = QLatin1String("/DeviceRGB");
+        break;
+    case Types::ColorTypeGreyscale:
+        m_imageColorSpace = QLatin1String("/DeviceGray");
+        break;
+    case Types::ColorTypeCMYK:
+        m_imageColorSpace = QLatin1String("/DeviceCMYK");
+        break;
+    default:
+        m_imageColorSpace = QString::fromLatin1("[/Indexed /DeviceRGB %1 <").arg(colorTable.count()-1); // -1, because PDF wants the highest index, not the number of entries
+        foreach (const QRgb &paletteEntry, colorTable) {
+            QString rgbHex = QString::fromLatin1("%1%2%3")
+                .arg(qRed(paletteEntry), 2, 16, QLatin1Char('0'))
+                .arg(qGreen(paletteEntry), 2, 16, QLatin1Char('0'))
+                .arg(qBlue(paletteEntry), 2, 16, QLatin1Char('0'));
+            m_imageColorSpace.append(rgbHex);
+        }
+        m_imageColorSpace.append(QLatin1String(">]"));
+    }
+
+    // In PdfImageModePerPage, each page gets its own crop in drawImage()
+    if (m_imageMode == Types::PdfImageModePerPage)
+        return 0;
+
+    int err = 0;
+    if (m_imageMode == Types::PdfImageModeTiled) {
+        m_tileColumnsCount = (sizePixels.width() + imageTileSize - 1) / imageTileSize;
+        const int tileRowsCount = (sizePixels.height() + imageTileSize - 1) / imageTileSize;
+        m_tileObjectIDs.fill(0, m_tileColumnsCount * tileRowsCount);
+        const QRect imageRect(QPoint(0, 0), sizePixels);
+        for (int tile = 0; tile < m_tileObjectIDs.count() && !err; tile++) {
+            const QRect tileRect((tile % m_tileColumnsCount) * imageTileSize, (tile / m_tileColumnsCount) * imageTileSize,
+                                 imageTileSize, imageTileSize);
+            err = saveImageXObject(tileRect.intersected(imageRect), m_tileObjectIDs[tile]);
+        }
+        return err;
+    }
+
+    err = addImageResourcesAndXObject();
+    if (!err)
+        err = saveImageXObject(QRect(QPoint(0, 0), sizePixels), m_objectImageID);
+
+    return err;
+}
+
+// Copies bitsCount bits which start at an arbitrary bit of source to
+// the beginning of destination.
+static void copyBits(const uchar *source, qint64 sourceBitOffset, uchar *destination, int bitsCount)
+{
+    source += sourceBitOffset / 8;
+    const int shift = sourceBitOffset % 8;
+    const int bytesCount = (bitsCount + 7) / 8;
+    if (shift == 0) {
+        memcpy(destination, source, bytesCount);
+        return;
+    }
+    // Only read the source bytes which actually contain the requested bits
+    const int sourceBytesCount = (shift + bitsCount + 7) / 8;
+    for (int byte = 0; byte < bytesCount; byte++) {
+        const uchar nextByte = byte + 1 < sourceBytesCount ? source[byte + 1] : 0;
+        destination[byte] = uchar((source[byte] << shift) | (nextByte >> (8 - shift)));
+    }
+}
+
+const uchar *PDFWriter::imageRow(int row)
+{
+    if (row < m_bandFirstRow || row >= m_bandFirstRow + m_bandRowsCount) {
+        m_bandFirstRow = row - row % m_bandHeight;
+        m_bandRowsCount = qMin(m_bandHeight, m_imageSizePixels.height() - m_bandFirstRow);
+        m_band.resize(int(m_imageBytesPerLine * m_bandRowsCount));
+        m_readRows(m_bandFirstRow, m_bandRowsCount, m_band.data());
+        reportProgress(Types::SavingStageImage, m_bandFirstRow + m_bandRowsCount, m_imageSizePixels.height());
+    }
+    return reinterpret_cast<const uchar*>(m_band.constData()) + (row - m_bandFirstRow) * m_imageBytesPerLine;
+}
+
+int PDFWriter::saveImageXObject(const QRect &sourceRect, int &objectID)
+{
+    const bool hasSoftMask = m_imageColorType == Types::ColorTypeRGBA;
+    const Types::ColorTypes actualColorType = hasSoftMask ? Types::ColorTypeRGB : m_imageColorType;
+    const int bitPerPixel = m_imageBitsPerPixel;
+    const int actualBitsPerPixel = hasSoftMask ? (bitPerPixel / 4) * 3 : bitPerPixel;
+    const int widthPixels = sourceRect.width();
+    const int heightPixels = sourceRect.height();
+    const int actualBytesPerLine = (widthPixels * actualBitsPerPixel + 7) / 8;
+    const qint64 leftBitOffset = qint64(sourceRect.left()) * bitPerPixel;
+
+    // Image object, its /Length, the soft mask object, its /Length
+    const QString sMaskString = hasSoftMask ?
+        QString::fromLatin1("/SMask %1 0 R" LINEFEED).arg(m_pdfObjectCount + 3) : QString();
+
+    const int bitsPerComponent =
+        actualColorType == Types::ColorTypePalette ? actualBitsPerPixel
+        : actualColorType == Types::ColorTypeMonochrome ? actualBitsPerPixel
+        : actualColorType == Types::ColorTypeGreyscale ? actualBitsPerPixel
+        : actualColorType == Types::ColorTypeCMYK ? (actualBitsPerPixel / 4)
+        : (actualBitsPerPixel / 3);
+    const int colors =
+        actualColorType == Types::ColorTypeCMYK ? 4
+        : actualColorType == Types::ColorTypeRGB ? 3
+        : 1;
+    // As PNG defines it for the filters
+    const int bytesPerPixel = qMax(1, actualBitsPerPixel / 8);
+
+    // Each pass splits the pixels and only keeps its own part
+    QByteArray alphaRow(hasSoftMask ? widthPixels : 0, 0);
+    QByteArray rgbRow(hasSoftMask ? actualBytesPerLine : 0, 0);
+
+    objectID = m_pdfObjectCount + 1;
+    int err = saveImageStream(
+        QString::fromLatin1(
+            "/ColorSpace %1" LINEFEED
+            "/Subtype /Image" LINEFEED
+            "/Width %2" LINEFEED
+            "/Type /XObject" LINEFEED
+            "/Height %3" LINEFEED
+            "/BitsPerComponent %4" LINEFEED
+            "%5"
+            "%6")
+            .arg(m_imageColorSpace)
+            .arg(widthPixels)
+            .arg(heightPixels)
+            .arg(bitsPerComponent)
+            .arg(decodeParameters(colors, bitsPerComponent, widthPixels))
+            .arg(sMaskString),
+        heightPixels, actualBytesPerLine, bytesPerPixel,
+        [&] (int row, char *destination) {
+            const uchar *sourceLine = imageRow(sourceRect.top() + row);
+            if (hasSoftMask)
+                PixelKernels::argbToRgbAndAlpha(sourceLine + leftBitOffset / 8, reinterpret_cast<uchar*>(destination),
+                                                reinterpret_cast<uchar*>(alphaRow.data()), widthPixels);
+            else
+                copyBits(sourceLine, leftBitOffset, reinterpret_cast<uchar*>(destination), widthPixels * bitPerPixel);
+        }
+    );
+
+    // The soft mask follows in a second pass over the same rows, so that it
+    // is never held in memory either.
+    if (!err && hasSoftMask) {
+        err = saveImageStream(
+            QString::fromLatin1(
+                "/ColorSpace /DeviceGray" LINEFEED
+                "/Subtype /Image" LINEFEED
+                "/Width %1" LINEFEED
+                "/Type /XObject" LINEFEED
+                "/Height %2" LINEFEED
+                "/BitsPerComponent 8" LINEFEED
+                "/Decode [ 0 1 ]" LINEFEED
+                "%3")
+                .arg(widthPixels)
+                .arg(heightPixels)
+                .arg(decodeParameters(1, 8, widthPixels)),
+            heightPixels, widthPixels, 1,
+            [&] (int row, char *destination) {
+                PixelKernels::argbToRgbAndAlpha(imageRow(sourceRect.top() + row) + leftBitOffset / 8,
+                                                reinterpret_cast<uchar*>(rgbRow.data()), reinterpret_cast<uchar*>(destination), widthPixels);
+            }
         );
-        m_outStream <<
-            LINEFEED "endstream" LINEFEED
-            "endobj";
-        m_firstPageID++;
     }
 
     return err;
@@ -299,7 +590,28 @@ int PDFWriter::startPage()
     int err = 0;
 
     m_pageContent.clear();
+    m_pageXObjects.clear();
+
+    return err;
+}
+
+int PDFWriter::finishPage()
+{
+    int err = m_pageError;
+    m_pageError = 0;
+
+    // Pages of PdfImageModePerPage and PdfImageModeTiled list their own image
+    // XObjects. Those which show nothing of the image get an empty dictionary
+    const QString resources =
+        !m_pageXObjects.isEmpty() ? QString::fromLatin1(
+            "<</XObject <<%1>>" LINEFEED
+            "/ProcSet [/PDF /Text /ImageC /ImageI /ImageB]" LINEFEED
+            ">>").arg(m_pageXObjects)
+        : m_objectResourcesID != 0 ? QString::fromLatin1("%1 0 R").arg(m_objectResourcesID)
+        : QString::fromLatin1("<< >>");
+
     addOffsetToXref();
+    m_pageObjectIDs.append(m_pdfObjectCount);
     m_outStream << QString::fromLatin1(
         LINEFEED "%1 0 obj" LINEFEED
         "<</Group <</CS /DeviceRGB" LINEFEED
@@ -308,25 +620,18 @@ int PDFWriter::startPage()
         ">>" LINEFEED
         "/Parent %2 0 R" LINEFEED
         "/MediaBox [0 0 %3 %4]" LINEFEED
-        "/Resources %5 0 R" LINEFEED
+        "/Resources %5" LINEFEED
         "/Contents %6 0 R" LINEFEED
         "/Type /Page" LINEFEED
         ">>" LINEFEED
         "endobj")
         .arg(m_pdfObjectCount)
-        .arg(m_firstPageID + m_contentPagesCount*2)
+        .arg(m_objectPagesID)
         .arg(m_mediaboxWidth, 0, 'f', valuePrecision)
         .arg(m_mediaboxHeight, 0, 'f', valuePrecision)
-        .arg(m_objectResourcesID)
+        .arg(resources)
         .arg(m_pdfObjectCount+1);
 
-    return err;
-}
-
-int PDFWriter::finishPage()
-{
-    int err = 0;
-
     addOffsetToXref();
     m_outStream << QString::fromLatin1(
         LINEFEED "%1 0 obj" LINEFEED
@@ -355,7 +660,13 @@ int PDFWriter::startSaving(QIODevice *outputDevice, int pages, qreal widthCm, qr
 
     m_outStream.setDevice(outputDevice);
     m_contentPagesCount = pages;
-    m_xref.clear();
+    m_pdfObjectCount = 0;
+    m_objectOffsets.clear();
+    m_pageObjectIDs.clear();
+    m_pageObjectIDs.reserve(pages);
+    m_objectResourcesID = 0;
+    m_tileObjectIDs.clear();
+    m_tileColumnsCount = 0;
     m_outStream << "%PDF-1.3" LINEFEED
         "%\xe2\xe3\xcf\xd3" ;
 
@@ -370,6 +681,9 @@ int PDFWriter::startSaving(QIODevice *outputDevice, int pages, qreal widthCm, qr
         .arg(m_pdfObjectCount)
         .arg(QDateTime::currentDateTime().toString(QLatin1String("yyyyMMddHHmmss")));
 
+    // The pages need to know their parent before it is written
+    m_objectPagesID = reserveObjectID();
+
     return err;
 }
 
@@ -377,26 +691,27 @@ int PDFWriter::finishSaving()
 {
     int err = 0;
 
-    addOffsetToXref();
-    m_objectPagesID = m_pdfObjectCount;
+    startObject(m_objectPagesID);
     QString kids;
-    for (int i = 0; i < m_contentPagesCount; i++)
-        kids.append(QString::fromLatin1("%1%2 0 R").arg(i != 0 ? QLatin1String(" ") : QString()).arg(i * 2 + m_firstPageID));
+    for (int i = 0; i < m_pageObjectIDs.count(); i++)
+        kids.append(QString::fromLatin1("%1%2 0 R").arg(i != 0 ? QLatin1String(" ") : QString()).arg(m_pageObjectIDs.at(i)));
+    const QString resources = m_objectResourcesID != 0 ?
+        QString::fromLatin1("/Resources %1 0 R" LINEFEED).arg(m_objectResourcesID) : QString();
     m_outStream << QString::fromLatin1(
         LINEFEED "%1 0 obj" LINEFEED
         "<</MediaBox [0 0 %2 %3]" LINEFEED
-        "/Resources %4 0 R" LINEFEED
+        "%4"
         "/Kids [%5]" LINEFEED
         "/Count %6" LINEFEED
         "/Type /Pages" LINEFEED
         ">>" LINEFEED
         "endobj")
-        .arg(m_pdfObjectCount)
+        .arg(m_objectPagesID)
         .arg(m_mediaboxWidth, 0, 'f', valuePrecision)
         .arg(m_mediaboxHeight, 0, 'f', valuePrecision)
-        .arg(m_objectResourcesID)
+        .arg(resources)
         .arg(kids)
-        .arg(m_contentPagesCount);
+        .arg(m_pageObjectIDs.count());
 
     addOffsetToXref();
     m_outStream << QString::fromLatin1(
@@ -406,15 +721,18 @@ int PDFWriter::finishSaving()
         ">>" LINEFEED
         "endobj")
         .arg(m_pdfObjectCount)
-        .arg(m_pdfObjectCount - 1);
+        .arg(m_objectPagesID);
 
     m_outStream.flush();
     const qint64 startxref = m_outStream.device()->size();
     m_outStream
         << QString::fromLatin1(LINEFEED "xref" LINEFEED "0 %1" LINEFEED "0000000000 65535 f " LINEFEED)
-        .arg(m_pdfObjectCount + 1)
-        << m_xref
-        << QString::fromLatin1(
+        .arg(m_pdfObjectCount + 1);
+    for (const qint64 offset : qAsConst(m_objectOffsets))
+        m_outStream << QString::fromLatin1("%1 %2 n " LINEFEED)
+            .arg(offset, 10, 10, QLatin1Char('0'))
+            .arg(0, 5, 10, QLatin1Char('0'));
+    m_outStream << QString::fromLatin1(
         "trailer" LINEFEED
         "<</Info %1 0 R" LINEFEED
         "/Root %2 0 R" LINEFEED
@@ -428,7 +746,7 @@ int PDFWriter::finishSaving()
         .arg(m_pdfObjectCount + 1)
         .arg(startxref);
 
-    m_xref.clear();
+    m_objectOffsets.clear();
     return err;
 }
 
@@ -443,20 +761,80 @@ QSizeF PDFWriter::size() const
     return {};
 }
 
+// Adds the XObject to the page resources and returns the code which draws
+// it where sourceRect lies within the whole image at imageRect.
+QString PDFWriter::pageImageCode(int objectID, const QRect &sourceRect, const QRectF &imageRect)
+{
+    const QString imageName = QString::fromLatin1("/Im%1").arg(objectID);
+    m_pageXObjects.append(QString::fromLatin1("%1 %2 0 R ").arg(imageName).arg(objectID));
+    const qreal horizontalPtPerPixel = imageRect.width() / m_imageSizePixels.width();
+    const qreal verticalPtPerPixel = imageRect.height() / m_imageSizePixels.height();
+    const QRectF rect(imageRect.left() + sourceRect.left() * horizontalPtPerPixel, imageRect.top() + sourceRect.top() * verticalPtPerPixel,
+                      sourceRect.width() * horizontalPtPerPixel, sourceRect.height() * verticalPtPerPixel);
+    return QString::fromLatin1(
+        "q %1 0 0 %2 %3 %4 cm" LINEFEED
+        "  %5 Do Q" LINEFEED)
+        .arg(rect.width(), 0, 'f', valuePrecision)
+        .arg(rect.height(), 0, 'f', valuePrecision)
+        .arg(rect.x(), 0, 'f', valuePrecision)
+        .arg(m_mediaboxHeight - rect.y() - rect.height(), 0, 'f', valuePrecision)
+        .arg(imageName);
+}
+
+// Without the visible pixels, all of them are embedded. The clipping path
+// cuts off the rest.
 void PDFWriter::drawImage(const QRectF &rect)
 {
+    drawImagePart(rect, QRect(QPoint(0, 0), m_imageSizePixels));
+}
+
+// sourceRect are the pixels which are at least partly on the page, as the
+// PosterLayout has worked them out.
+void PDFWriter::drawImagePart(const QRectF &rect, const QRect &sourceRect)
+{
+    const QRectF imageRect(cm2Pt(rect.x()), cm2Pt(rect.y()), cm2Pt(rect.width()), cm2Pt(rect.height()));
+    QString imagesCode;
+
+    if (m_imageMode == Types::PdfImageModeShared) {
+        imagesCode = QString::fromLatin1(
+            "q %1 0 0 %2 %3 %4 cm" LINEFEED
+            "  /Im1 Do Q" LINEFEED)
+            .arg(imageRect.width(), 0, 'f', valuePrecision)
+            .arg(imageRect.height(), 0, 'f', valuePrecision)
+            .arg(imageRect.x(), 0, 'f', valuePrecision)
+            .arg(m_mediaboxHeight - imageRect.y() - imageRect.height(), 0, 'f', valuePrecision);
+    } else {
+        if (sourceRect.isEmpty())
+            return;
+        if (m_imageMode == Types::PdfImageModePerPage) {
+            int objectID = 0;
+            const int err = saveImageXObject(sourceRect, objectID);
+            if (err) {
+                m_pageError = err;
+                return;
+            }
+            imagesCode = pageImageCode(objectID, sourceRect, imageRect);
+        } else {
+            // Only reference the tiles which intersect the visible pixels
+            const QRect imagePixelsRect(QPoint(0, 0), m_imageSizePixels);
+            for (int row = sourceRect.top() / imageTileSize; row <= sourceRect.bottom() / imageTileSize; row++) {
+                for (int column = sourceRect.left() / imageTileSize; column <= sourceRect.right() / imageTileSize; column++) {
+                    const QRect tileRect = QRect(column * imageTileSize, row * imageTileSize, imageTileSize, imageTileSize)
+                        .intersected(imagePixelsRect);
+                    imagesCode.append(pageImageCode(m_tileObjectIDs.at(row * m_tileColumnsCount + column), tileRect, imageRect));
+                }
+            }
+        }
+    }
+
     const QString imageCode = QString::fromLatin1(
         "0 w" LINEFEED
         "q 0 0 %1 %2 re W* n" LINEFEED
-        "q %3 0 0 %4 %5 %6 cm" LINEFEED
-        "  /Im1 Do Q" LINEFEED
+        "%3"
         "Q ")
         .arg(m_mediaboxWidth, 0, 'f', valuePrecision)
         .arg(m_mediaboxHeight, 0, 'f', valuePrecision)
-        .arg(cm2Pt(rect.width()), 0, 'f', valuePrecision)
-        .arg(cm2Pt(rect.height()), 0, 'f', valuePrecision)
-        .arg(cm2Pt(rect.x()), 0, 'f', valuePrecision)
-        .arg(m_mediaboxHeight-cm2Pt(rect.y())-cm2Pt(rect.height()), 0, 'f', valuePrecision);
+        .arg(imagesCode);
 
     m_pageContent.append(imageCode);
 }
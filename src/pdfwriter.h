@@ -28,16 +28,35 @@
 #include <QObject>
 #include <QRgb>
 #include <QTextStream>
+#include <QThreadPool>
+#include <QVector>
+
+#include <functional>
+
+class MappedFile;
+class PassthroughImage;
 
 class PDFWriter: public QObject, public PaintCanvasInterface
 {
 public:
+    // Writes rowsCount rows of the image, starting at firstRow, to destination.
+    // The layout is that of ImageLoaderInterface::bits().
+    typedef std::function<void(int firstRow, int rowsCount, char *destination)> RowsReader;
+
     PDFWriter(QObject *parent = nullptr);
 
+    void setCompressionLevel(int level);
+    void setCompressionThreadsCount(int count);
+    void setImageMode(Types::PdfImageModes mode);
+    void setPngPredictor(Types::PngPredictors predictor);
+    void setDeflateBackend(Types::DeflateBackends backend);
+    void setProgressHandler(const Types::SavingProgressHandler &handler);
+
     void addOffsetToXref();
     int addImageResourcesAndXObject();
-    int saveJpegImage(const QString &jpegFileName, const QSize &sizePixels, Types::ColorTypes colorType);
-    int saveImage(const QByteArray &imageData, const QSize &sizePixels, int bitPerPixel, Types::ColorTypes colorType, const QVector<QRgb> &colorTable);
+    int saveJpegImage(const MappedFile &jpegFile, const QSize &sizePixels, Types::ColorTypes colorType);
+    int savePassthroughImage(const PassthroughImage &image);
+    int saveImage(const RowsReader &readRows, const QSize &sizePixels, int bitPerPixel, Types::ColorTypes colorType, const QVector<QRgb> &colorTable);
     int startPage();
     int finishPage();
     int startSaving(QIODevice *outputDevice, int pages, qreal widthCm, qreal heightCm);
@@ -45,16 +64,50 @@ public:
     void drawFilledRect(const QRectF&, const QBrush &brush) override;
     QSizeF size() const override;
     void drawImage(const QRectF &rect) override;
+    void drawImagePart(const QRectF &rect, const QRect &sourceRect) override;
     void drawOverlayText(const QPointF &position, int flags, int size, const QString &text) override;
 
 private:
-    QString m_xref;
+    bool reportProgress(Types::SavingStages stage, qint64 done, qint64 total);
+    int reserveObjectID();
+    void startObject(int objectID);
+    QString decodeParameters(int colors, int bitsPerComponent, int columns) const;
+    int saveImageStream(const QString &dictionary, int rowsCount, int bytesPerRow, int bytesPerPixel, const std::function<void(int row, char *destination)> &fillRow);
+    int saveImageXObject(const QRect &sourceRect, int &objectID);
+    const uchar *imageRow(int row);
+    QString pageImageCode(int objectID, const QRect &sourceRect, const QRectF &imageRect);
+
+    QVector<qint64> m_objectOffsets;
     int m_pdfObjectCount = 0;
     int m_contentPagesCount = 0;
     int m_objectPagesID = 0;
-    int m_firstPageID = 5; // will be ++ed if the image has a SMask
+    QVector<int> m_pageObjectIDs;
     int m_objectResourcesID = 0;
     int m_objectImageID = 0;
+    QVector<int> m_tileObjectIDs;
+    int m_tileColumnsCount = 0;
+    Types::PdfImageModes m_imageMode = Types::PdfImageModeShared;
+    RowsReader m_readRows;
+    qint64 m_imageBytesPerLine = 0;
+    QByteArray m_band; // The rows which are currently read from m_readRows
+    int m_bandHeight = 0;
+    int m_bandFirstRow = 0;
+    int m_bandRowsCount = 0;
+    QSize m_imageSizePixels;
+    int m_imageBitsPerPixel = 0;
+    Types::ColorTypes m_imageColorType = Types::ColorTypeRGB;
+    QString m_imageColorSpace;
+    QString m_pageXObjects;
+    int m_pageError = 0;
+    int m_compressionLevel = 9;
+    int m_compressionThreadsCount = 1;
+    QThreadPool m_compressionThreadPool; // Shared by all FlateStreams of the document
+    Types::PngPredictors m_pngPredictor = Types::PngPredictorNone;
+    Types::DeflateBackends m_deflateBackend = Types::DeflateBackendZlib;
+    Types::SavingProgressHandler m_progressHandler;
+    bool m_canceled = false;
+    qint64 m_compressedBytes = 0;
+    qint64 m_compressionTotalBytes = 0; // 0 if only known page by page
     qreal m_mediaboxWidth = 5000.0;
     qreal m_mediaboxHeight = 5000.0;
     QString m_pageContent;
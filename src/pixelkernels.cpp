@@ -0,0 +1,532 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "pixelkernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define PIXELKERNELS_SSE2
+#   include <emmintrin.h>
+#   if defined(Q_CC_GNU) && !defined(Q_CC_INTEL)
+        // GCC and Clang compile single functions for SSSE3 and AVX2, which run after a CPU check
+#       define PIXELKERNELS_AVX2
+#       define PIXELKERNELS_SSSE3_FUNCTION __attribute__((target("ssse3")))
+#       define PIXELKERNELS_AVX2_FUNCTION __attribute__((target("avx2")))
+#       include <immintrin.h>
+#   endif
+#endif
+
+// Rounded a * b / 255 for a, b in [0, 255]
+static inline uint multiplyBytes(uint a, uint b)
+{
+    const uint product = a * b + 128;
+    return (product + (product >> 8)) >> 8;
+}
+
+static void cmykToRgbGeneric(const uchar *cmyk, QRgb *rgb, int pixelsCount, bool inverted)
+{
+    // The RGB channels are (255 - C) * (255 - K) / 255 and so on. Inverted
+    // values are 255 - C already.
+    const uint mask = inverted ? 0 : 0xff;
+    for (int pixel = 0; pixel < pixelsCount; pixel++) {
+        const uint k = cmyk[3] ^ mask;
+        *rgb++ = qRgb(int(multiplyBytes(cmyk[0] ^ mask, k)),
+                      int(multiplyBytes(cmyk[1] ^ mask, k)),
+                      int(multiplyBytes(cmyk[2] ^ mask, k)));
+        cmyk += 4;
+    }
+}
+
+#ifdef PIXELKERNELS_SSE2
+// Two pixels as eight 16 bit values C M Y K C M Y K in, B G R K B G R K out
+static inline __m128i cmykToBgrkSse2(__m128i cmyk)
+{
+    const __m128i k = _mm_shufflehi_epi16(_mm_shufflelo_epi16(cmyk, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i product = _mm_add_epi16(_mm_mullo_epi16(cmyk, k), _mm_set1_epi16(128));
+    product = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(product, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+static void cmykToRgbSse2(const uchar *cmyk, QRgb *rgb, int pixelsCount, bool inverted)
+{
+    const __m128i mask = _mm_set1_epi8(inverted ? 0 : char(0xff));
+    const __m128i alpha = _mm_set1_epi32(int(0xff000000));
+    const __m128i zero = _mm_setzero_si128();
+    int pixel = 0;
+    for (; pixel + 4 <= pixelsCount; pixel += 4) {
+        const __m128i source = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cmyk + pixel * 4)), mask);
+        const __m128i low = cmykToBgrkSse2(_mm_unpacklo_epi8(source, zero));
+        const __m128i high = cmykToBgrkSse2(_mm_unpackhi_epi8(source, zero));
+        // Little endian BGRA bytes are QRgbs
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + pixel), _mm_or_si128(_mm_packus_epi16(low, high), alpha));
+    }
+    cmykToRgbGeneric(cmyk + pixel * 4, rgb + pixel, pixelsCount - pixel, inverted);
+}
+#endif // PIXELKERNELS_SSE2
+
+#ifdef PIXELKERNELS_AVX2
+PIXELKERNELS_AVX2_FUNCTION
+static inline __m256i cmykToBgrkAvx2(__m256i cmyk)
+{
+    const __m256i k = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(cmyk, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(cmyk, k), _mm256_set1_epi16(128));
+    product = _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(product, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+PIXELKERNELS_AVX2_FUNCTION
+static void cmykToRgbAvx2(const uchar *cmyk, QRgb *rgb, int pixelsCount, bool inverted)
+{
+    const __m256i mask = _mm256_set1_epi8(inverted ? 0 : char(0xff));
+    const __m256i alpha = _mm256_set1_epi32(int(0xff000000));
+    const __m256i zero = _mm256_setzero_si256();
+    int pixel = 0;
+    for (; pixel + 8 <= pixelsCount; pixel += 8) {
+        const __m256i source = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cmyk + pixel * 4)), mask);
+        // Unpacking and packing work within the 128 bit lanes, which keeps the pixel order
+        const __m256i low = cmykToBgrkAvx2(_mm256_unpacklo_epi8(source, zero));
+        const __m256i high = cmykToBgrkAvx2(_mm256_unpackhi_epi8(source, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgb + pixel), _mm256_or_si256(_mm256_packus_epi16(low, high), alpha));
+    }
+    cmykToRgbSse2(cmyk + pixel * 4, rgb + pixel, pixelsCount - pixel, inverted);
+}
+
+static bool hasSsse3()
+{
+    static const bool result = __builtin_cpu_supports("ssse3");
+    return result;
+}
+
+static bool hasAvx2()
+{
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
+}
+#endif // PIXELKERNELS_AVX2
+
+static void bgraToRgbGeneric(const uchar *bgra, uchar *rgb, int pixelsCount)
+{
+    for (int pixel = 0; pixel < pixelsCount; pixel++) {
+        rgb[0] = bgra[2];
+        rgb[1] = bgra[1];
+        rgb[2] = bgra[0];
+        bgra += 4;
+        rgb += 3;
+    }
+}
+
+static void bgraToArgbGeneric(const uchar *bgra, uchar *argb, int pixelsCount)
+{
+    for (int pixel = 0; pixel < pixelsCount; pixel++) {
+        const uchar blue = bgra[0];
+        const uchar green = bgra[1];
+        argb[0] = bgra[3];
+        argb[1] = bgra[2];
+        argb[2] = green;
+        argb[3] = blue;
+        bgra += 4;
+        argb += 4;
+    }
+}
+
+static void bgrToRgbGeneric(const uchar *bgr, uchar *rgb, int pixelsCount)
+{
+    for (int pixel = 0; pixel < pixelsCount; pixel++) {
+        const uchar blue = bgr[0];
+        rgb[1] = bgr[1];
+        rgb[0] = bgr[2];
+        rgb[2] = blue;
+        bgr += 3;
+        rgb += 3;
+    }
+}
+
+static void byteSwap16Generic(const quint16 *source, quint16 *destination, int valuesCount)
+{
+    for (int value = 0; value < valuesCount; value++)
+        destination[value] = quint16((source[value] >> 8) | (source[value] << 8));
+}
+
+static void argbToRgbAndAlphaGeneric(const uchar *argb, uchar *rgb, uchar *alpha, int pixelsCount)
+{
+    for (int pixel = 0; pixel < pixelsCount; pixel++) {
+        *alpha++ = argb[0];
+        rgb[0] = argb[1];
+        rgb[1] = argb[2];
+        rgb[2] = argb[3];
+        argb += 4;
+        rgb += 3;
+    }
+}
+
+static void pngFilterSubGeneric(const uchar *row, uchar *filtered, int bytesCount, int bytesPerPixel, int start)
+{
+    for (int byte = start; byte < bytesCount; byte++)
+        filtered[byte] = uchar(row[byte] - (byte >= bytesPerPixel ? row[byte - bytesPerPixel] : 0));
+}
+
+static void pngFilterUpGeneric(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount, int start)
+{
+    for (int byte = start; byte < bytesCount; byte++)
+        filtered[byte] = uchar(row[byte] - previousRow[byte]);
+}
+
+static void pngFilterPaethGeneric(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount, int bytesPerPixel, int start)
+{
+    for (int byte = start; byte < bytesCount; byte++) {
+        const int a = byte >= bytesPerPixel ? row[byte - bytesPerPixel] : 0; // Left
+        const int b = previousRow[byte]; // Up
+        const int c = byte >= bytesPerPixel ? previousRow[byte - bytesPerPixel] : 0; // Up left
+        const int pa = qAbs(b - c);
+        const int pb = qAbs(a - c);
+        const int pc = qAbs(a + b - 2 * c);
+        const int predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+        filtered[byte] = uchar(row[byte] - predictor);
+    }
+}
+
+static quint64 pngFilterCostGeneric(const uchar *filtered, int bytesCount, int start)
+{
+    quint64 cost = 0;
+    for (int byte = start; byte < bytesCount; byte++)
+        cost += qMin(filtered[byte], uchar(-filtered[byte]));
+    return cost;
+}
+
+#ifdef PIXELKERNELS_SSE2
+// The vector loops start behind the first pixel, which has no left neighbor
+static void pngFilterSubSse2(const uchar *row, uchar *filtered, int bytesCount, int bytesPerPixel)
+{
+    int byte = qMin(bytesPerPixel, bytesCount);
+    pngFilterSubGeneric(row, filtered, byte, bytesPerPixel, 0);
+    for (; byte + 16 <= bytesCount; byte += 16) {
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + byte));
+        const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + byte - bytesPerPixel));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(filtered + byte), _mm_sub_epi8(current, left));
+    }
+    pngFilterSubGeneric(row, filtered, bytesCount, bytesPerPixel, byte);
+}
+
+static void pngFilterUpSse2(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount)
+{
+    int byte = 0;
+    for (; byte + 16 <= bytesCount; byte += 16) {
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + byte));
+        const __m128i up = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previousRow + byte));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(filtered + byte), _mm_sub_epi8(current, up));
+    }
+    pngFilterUpGeneric(row, previousRow, filtered, bytesCount, byte);
+}
+
+// Eight predictors at once, as 16 bit values
+static inline __m128i paethPredictorSse2(__m128i a, __m128i b, __m128i c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bc = _mm_sub_epi16(b, c);
+    const __m128i ac = _mm_sub_epi16(a, c);
+    const __m128i abcc = _mm_add_epi16(bc, ac);
+    const __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+    const __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+    const __m128i pc = _mm_max_epi16(abcc, _mm_sub_epi16(zero, abcc));
+    const __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    const __m128i useC = _mm_cmpgt_epi16(pb, pc);
+    const __m128i bOrC = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+    return _mm_or_si128(_mm_and_si128(notA, bOrC), _mm_andnot_si128(notA, a));
+}
+
+static void pngFilterPaethSse2(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount, int bytesPerPixel)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int byte = qMin(bytesPerPixel, bytesCount);
+    pngFilterPaethGeneric(row, previousRow, filtered, byte, bytesPerPixel, 0);
+    for (; byte + 16 <= bytesCount; byte += 16) {
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + byte));
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + byte - bytesPerPixel));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previousRow + byte));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previousRow + byte - bytesPerPixel));
+        const __m128i low = paethPredictorSse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        const __m128i high = paethPredictorSse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(filtered + byte), _mm_sub_epi8(current, _mm_packus_epi16(low, high)));
+    }
+    pngFilterPaethGeneric(row, previousRow, filtered, bytesCount, bytesPerPixel, byte);
+}
+
+static quint64 pngFilterCostSse2(const uchar *filtered, int bytesCount)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums = zero;
+    int byte = 0;
+    for (; byte + 16 <= bytesCount; byte += 16) {
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(filtered + byte));
+        const __m128i magnitudes = _mm_min_epu8(values, _mm_sub_epi8(zero, values));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(magnitudes, zero));
+    }
+    quint64 halves[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(halves), sums);
+    return halves[0] + halves[1] + pngFilterCostGeneric(filtered, bytesCount, byte);
+}
+#endif // PIXELKERNELS_SSE2
+
+#ifdef PIXELKERNELS_AVX2
+PIXELKERNELS_AVX2_FUNCTION
+static inline __m256i paethPredictorAvx2(__m256i a, __m256i b, __m256i c)
+{
+    const __m256i bc = _mm256_sub_epi16(b, c);
+    const __m256i ac = _mm256_sub_epi16(a, c);
+    const __m256i pa = _mm256_abs_epi16(bc);
+    const __m256i pb = _mm256_abs_epi16(ac);
+    const __m256i pc = _mm256_abs_epi16(_mm256_add_epi16(bc, ac));
+    const __m256i notA = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+    const __m256i bOrC = _mm256_blendv_epi8(b, c, _mm256_cmpgt_epi16(pb, pc));
+    return _mm256_blendv_epi8(a, bOrC, notA);
+}
+
+PIXELKERNELS_AVX2_FUNCTION
+static void pngFilterPaethAvx2(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount, int bytesPerPixel)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int byte = qMin(bytesPerPixel, bytesCount);
+    pngFilterPaethGeneric(row, previousRow, filtered, byte, bytesPerPixel, 0);
+    for (; byte + 32 <= bytesCount; byte += 32) {
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + byte));
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + byte - bytesPerPixel));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previousRow + byte));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previousRow + byte - bytesPerPixel));
+        // Unpacking and packing work within the 128 bit lanes, which keeps the byte order
+        const __m256i low = paethPredictorAvx2(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(c, zero));
+        const __m256i high = paethPredictorAvx2(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(c, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(filtered + byte), _mm256_sub_epi8(current, _mm256_packus_epi16(low, high)));
+    }
+    pngFilterPaethGeneric(row, previousRow, filtered, bytesCount, bytesPerPixel, byte);
+}
+#endif // PIXELKERNELS_AVX2
+
+#ifdef PIXELKERNELS_AVX2
+// Packs four 12 byte results of 4 to 3 byte shuffles into 48 bytes
+PIXELKERNELS_SSSE3_FUNCTION
+static inline void storeTriplets(uchar *destination, __m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i *target = reinterpret_cast<__m128i*>(destination);
+    _mm_storeu_si128(target, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+    _mm_storeu_si128(target + 1, _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+    _mm_storeu_si128(target + 2, _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+}
+
+PIXELKERNELS_SSSE3_FUNCTION
+static void bgraToRgbSsse3(const uchar *bgra, uchar *rgb, int pixelsCount)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i *source = reinterpret_cast<const __m128i*>(bgra);
+    int pixel = 0;
+    for (; pixel + 16 <= pixelsCount; pixel += 16, source += 4)
+        storeTriplets(rgb + pixel * 3,
+                      _mm_shuffle_epi8(_mm_loadu_si128(source), shuffle),
+                      _mm_shuffle_epi8(_mm_loadu_si128(source + 1), shuffle),
+                      _mm_shuffle_epi8(_mm_loadu_si128(source + 2), shuffle),
+                      _mm_shuffle_epi8(_mm_loadu_si128(source + 3), shuffle));
+    bgraToRgbGeneric(bgra + pixel * 4, rgb + pixel * 3, pixelsCount - pixel);
+}
+
+PIXELKERNELS_SSSE3_FUNCTION
+static void bgraToArgbSsse3(const uchar *bgra, uchar *argb, int pixelsCount)
+{
+    const __m128i shuffle = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    int pixel = 0;
+    for (; pixel + 4 <= pixelsCount; pixel += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(argb + pixel * 4),
+                         _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bgra + pixel * 4)), shuffle));
+    bgraToArgbGeneric(bgra + pixel * 4, argb + pixel * 4, pixelsCount - pixel);
+}
+
+PIXELKERNELS_AVX2_FUNCTION
+static void bgraToArgbAvx2(const uchar *bgra, uchar *argb, int pixelsCount)
+{
+    const __m256i shuffle = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    int pixel = 0;
+    for (; pixel + 8 <= pixelsCount; pixel += 8)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(argb + pixel * 4),
+                            _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bgra + pixel * 4)), shuffle));
+    bgraToArgbSsse3(bgra + pixel * 4, argb + pixel * 4, pixelsCount - pixel);
+}
+
+PIXELKERNELS_SSSE3_FUNCTION
+static void bgrToRgbSsse3(const uchar *bgr, uchar *rgb, int pixelsCount)
+{
+    // Five pixels per 16 bytes. The 16th byte is written back unchanged,
+    // and gets swapped in the next round.
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    int pixel = 0;
+    for (; pixel + 6 <= pixelsCount; pixel += 5)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + pixel * 3),
+                         _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + pixel * 3)), shuffle));
+    bgrToRgbGeneric(bgr + pixel * 3, rgb + pixel * 3, pixelsCount - pixel);
+}
+
+PIXELKERNELS_SSSE3_FUNCTION
+static void byteSwap16Ssse3(const quint16 *source, quint16 *destination, int valuesCount)
+{
+    const __m128i shuffle = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int value = 0;
+    for (; value + 8 <= valuesCount; value += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + value),
+                         _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + value)), shuffle));
+    byteSwap16Generic(source + value, destination + value, valuesCount - value);
+}
+
+PIXELKERNELS_AVX2_FUNCTION
+static void byteSwap16Avx2(const quint16 *source, quint16 *destination, int valuesCount)
+{
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                             1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int value = 0;
+    for (; value + 16 <= valuesCount; value += 16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + value),
+                            _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + value)), shuffle));
+    byteSwap16Ssse3(source + value, destination + value, valuesCount - value);
+}
+
+PIXELKERNELS_SSSE3_FUNCTION
+static void argbToRgbAndAlphaSsse3(const uchar *argb, uchar *rgb, uchar *alpha, int pixelsCount)
+{
+    const __m128i rgbShuffle = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    const __m128i alphaShuffle = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i *source = reinterpret_cast<const __m128i*>(argb);
+    int pixel = 0;
+    for (; pixel + 16 <= pixelsCount; pixel += 16, source += 4) {
+        const __m128i a = _mm_loadu_si128(source);
+        const __m128i b = _mm_loadu_si128(source + 1);
+        const __m128i c = _mm_loadu_si128(source + 2);
+        const __m128i d = _mm_loadu_si128(source + 3);
+        storeTriplets(rgb + pixel * 3, _mm_shuffle_epi8(a, rgbShuffle), _mm_shuffle_epi8(b, rgbShuffle),
+                      _mm_shuffle_epi8(c, rgbShuffle), _mm_shuffle_epi8(d, rgbShuffle));
+        const __m128i alphas = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(a, alphaShuffle), _mm_slli_si128(_mm_shuffle_epi8(b, alphaShuffle), 4)),
+            _mm_or_si128(_mm_slli_si128(_mm_shuffle_epi8(c, alphaShuffle), 8), _mm_slli_si128(_mm_shuffle_epi8(d, alphaShuffle), 12)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(alpha + pixel), alphas);
+    }
+    argbToRgbAndAlphaGeneric(argb + pixel * 4, rgb + pixel * 3, alpha + pixel, pixelsCount - pixel);
+}
+#endif // PIXELKERNELS_AVX2
+
+void PixelKernels::cmykToRgb(const uchar *cmyk, QRgb *rgb, int pixelsCount, bool inverted)
+{
+#if defined(PIXELKERNELS_AVX2)
+    if (hasAvx2())
+        cmykToRgbAvx2(cmyk, rgb, pixelsCount, inverted);
+    else
+        cmykToRgbSse2(cmyk, rgb, pixelsCount, inverted);
+#elif defined(PIXELKERNELS_SSE2)
+    cmykToRgbSse2(cmyk, rgb, pixelsCount, inverted);
+#else
+    cmykToRgbGeneric(cmyk, rgb, pixelsCount, inverted);
+#endif
+}
+
+void PixelKernels::bgraToRgb(const uchar *bgra, uchar *rgb, int pixelsCount)
+{
+#ifdef PIXELKERNELS_AVX2
+    if (hasSsse3())
+        return bgraToRgbSsse3(bgra, rgb, pixelsCount);
+#endif
+    bgraToRgbGeneric(bgra, rgb, pixelsCount);
+}
+
+void PixelKernels::bgraToArgb(const uchar *bgra, uchar *argb, int pixelsCount)
+{
+#ifdef PIXELKERNELS_AVX2
+    if (hasAvx2())
+        return bgraToArgbAvx2(bgra, argb, pixelsCount);
+    if (hasSsse3())
+        return bgraToArgbSsse3(bgra, argb, pixelsCount);
+#endif
+    bgraToArgbGeneric(bgra, argb, pixelsCount);
+}
+
+void PixelKernels::bgrToRgb(const uchar *bgr, uchar *rgb, int pixelsCount)
+{
+#ifdef PIXELKERNELS_AVX2
+    if (hasSsse3())
+        return bgrToRgbSsse3(bgr, rgb, pixelsCount);
+#endif
+    bgrToRgbGeneric(bgr, rgb, pixelsCount);
+}
+
+void PixelKernels::byteSwap16(const quint16 *source, quint16 *destination, int valuesCount)
+{
+#ifdef PIXELKERNELS_AVX2
+    if (hasAvx2())
+        return byteSwap16Avx2(source, destination, valuesCount);
+    if (hasSsse3())
+        return byteSwap16Ssse3(source, destination, valuesCount);
+#endif
+    byteSwap16Generic(source, destination, valuesCount);
+}
+
+void PixelKernels::argbToRgbAndAlpha(const uchar *argb, uchar *rgb, uchar *alpha, int pixelsCount)
+{
+#ifdef PIXELKERNELS_AVX2
+    if (hasSsse3())
+        return argbToRgbAndAlphaSsse3(argb, rgb, alpha, pixelsCount);
+#endif
+    argbToRgbAndAlphaGeneric(argb, rgb, alpha, pixelsCount);
+}
+
+void PixelKernels::pngFilterSub(const uchar *row, uchar *filtered, int bytesCount, int bytesPerPixel)
+{
+#ifdef PIXELKERNELS_SSE2
+    pngFilterSubSse2(row, filtered, bytesCount, bytesPerPixel);
+#else
+    pngFilterSubGeneric(row, filtered, bytesCount, bytesPerPixel, 0);
+#endif
+}
+
+void PixelKernels::pngFilterUp(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount)
+{
+#ifdef PIXELKERNELS_SSE2
+    pngFilterUpSse2(row, previousRow, filtered, bytesCount);
+#else
+    pngFilterUpGeneric(row, previousRow, filtered, bytesCount, 0);
+#endif
+}
+
+void PixelKernels::pngFilterPaeth(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount, int bytesPerPixel)
+{
+#if defined(PIXELKERNELS_AVX2)
+    if (hasAvx2())
+        pngFilterPaethAvx2(row, previousRow, filtered, bytesCount, bytesPerPixel);
+    else
+        pngFilterPaethSse2(row, previousRow, filtered, bytesCount, bytesPerPixel);
+#elif defined(PIXELKERNELS_SSE2)
+    pngFilterPaethSse2(row, previousRow, filtered, bytesCount, bytesPerPixel);
+#else
+    pngFilterPaethGeneric(row, previousRow, filtered, bytesCount, bytesPerPixel, 0);
+#endif
+}
+
+quint64 PixelKernels::pngFilterCost(const uchar *filtered, int bytesCount)
+{
+#ifdef PIXELKERNELS_SSE2
+    return pngFilterCostSse2(filtered, bytesCount);
+#else
+    return pngFilterCostGeneric(filtered, bytesCount, 0);
+#endif
+}
@@ -0,0 +1,55 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include <QRgb>
+
+// Conversion loops over whole scanlines. The x86 builds pick SSE2, SSSE3 or
+// AVX2 variants at runtime, other platforms use the portable ones.
+// Functions which take source and destination may work in place.
+class PixelKernels
+{
+public:
+    // 4 bytes per pixel in, opaque QRgbs out. Adobe writes CMYK JPEGs with
+    // inverted values, for those pass inverted = true.
+    static void cmykToRgb(const uchar *cmyk, QRgb *rgb, int pixelsCount, bool inverted);
+
+    // B G R A bytes (little endian QRgbs, FreeImage) to R G B bytes. Not in place
+    static void bgraToRgb(const uchar *bgra, uchar *rgb, int pixelsCount);
+    // B G R A bytes to A R G B bytes
+    static void bgraToArgb(const uchar *bgra, uchar *argb, int pixelsCount);
+    // B G R bytes to R G B bytes, and vice versa
+    static void bgrToRgb(const uchar *bgr, uchar *rgb, int pixelsCount);
+    // Swaps the bytes of 16 bit values
+    static void byteSwap16(const quint16 *source, quint16 *destination, int valuesCount);
+    // A R G B bytes to R G B bytes and a separate plane of alpha bytes. Not in place
+    static void argbToRgbAndAlpha(const uchar *argb, uchar *rgb, uchar *alpha, int pixelsCount);
+
+    // PNG filters of one row, without the filter type byte. previousRow is the
+    // unfiltered row above, all zeros for the first row. Not in place
+    static void pngFilterSub(const uchar *row, uchar *filtered, int bytesCount, int bytesPerPixel);
+    static void pngFilterUp(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount);
+    static void pngFilterPaeth(const uchar *row, const uchar *previousRow, uchar *filtered, int bytesCount, int bytesPerPixel);
+    // Sum of the filtered bytes as signed magnitudes. Lower usually compresses better
+    static quint64 pngFilterCost(const uchar *filtered, int bytesCount);
+};
@@ -1,31 +1,140 @@
+QT += \
+    concurrent
+
 VPATH = $$PWD
 INCLUDEPATH += \
     $$PWD
 
 SOURCES += \
+    batchrenderer.cpp \
+    commandline.cpp \
     controller.cpp \
+    deflater.cpp \
+    flatestream.cpp \
+    mappedfile.cpp \
     mainwindow.cpp \
     wizard.cpp \
+    pagerasterizer.cpp \
     paintcanvas.cpp \
+    passthroughimage.cpp \
+    pixelkernels.cpp \
     pdfwriter.cpp \
     posterazorcore.cpp \
+    posterlayout.cpp \
     snapspinbox.cpp \
+    tiledimage.cpp \
+    tiledimagestore.cpp \
     types.cpp \
     wizardcontroller.cpp
 
+# zlib deflates the PDF image streams while they are written
+win32:INCLUDEPATH += \
+    $$[QT_INSTALL_HEADERS]/QtZlib
+
+!win32:LIBS += \
+    -lz
+
+# Optional faster deflate implementations, chosen with the DeflateBackend setting.
+# Found with pkg-config. Without it, "CONFIG+=libdeflate" or "CONFIG+=zlibng"
+# links them from the default search paths, "CONFIG+=no_libdeflate" or
+# "CONFIG+=no_zlibng" leaves them out.
+!win32:!no_libdeflate:!libdeflate {
+    CONFIG += link_pkgconfig
+    packagesExist(libdeflate) {
+        PKGCONFIG += libdeflate
+        DEFINES += LIBDEFLATE_LIB
+    }
+}
+libdeflate {
+    DEFINES += LIBDEFLATE_LIB
+    LIBS += \
+        -ldeflate
+}
+
+!win32:!no_zlibng:!zlibng {
+    CONFIG += link_pkgconfig
+    packagesExist(zlib-ng) {
+        PKGCONFIG += zlib-ng
+        DEFINES += ZLIBNG_LIB
+    }
+}
+zlibng {
+    DEFINES += ZLIBNG_LIB
+    LIBS += \
+        -lz-ng
+}
+
+contains (DEFINES, ZLIBNG_LIB) {
+    SOURCES += \
+        deflaterzlibng.cpp
+}
+
+# Optional decoders for images which are too large for the memory. TiledImage
+# decodes them in a single pass, which the Qt image plugins cannot do. Found
+# and switched like the deflate implementations above.
+!win32:!no_libjpeg:!libjpeg {
+    CONFIG += link_pkgconfig
+    packagesExist(libjpeg) {
+        PKGCONFIG += libjpeg
+        DEFINES += LIBJPEG_LIB
+    }
+}
+libjpeg {
+    DEFINES += LIBJPEG_LIB
+    LIBS += \
+        -ljpeg
+}
+
+!win32:!no_libpng:!libpng {
+    CONFIG += link_pkgconfig
+    packagesExist(libpng) {
+        PKGCONFIG += libpng
+        DEFINES += LIBPNG_LIB
+    }
+}
+libpng {
+    DEFINES += LIBPNG_LIB
+    LIBS += \
+        -lpng
+}
+
+!win32:!no_libtiff:!libtiff {
+    CONFIG += link_pkgconfig
+    packagesExist(libtiff-4) {
+        PKGCONFIG += libtiff-4
+        DEFINES += LIBTIFF_LIB
+    }
+}
+libtiff {
+    DEFINES += LIBTIFF_LIB
+    LIBS += \
+        -ltiff
+}
+
 macx:SOURCES += \
     macosstylehelpers.cpp
 
 HEADERS += \
+    batchrenderer.h \
+    commandline.h \
     controller.h \
+    deflater.h \
+    flatestream.h \
     imageloaderinterface.h \
     mainwindow.h \
+    mappedfile.h \
     wizard.h \
+    pagerasterizer.h \
     paintcanvas.h \
     paintcanvasinterface.h \
+    passthroughimage.h \
+    pixelkernels.h \
     pdfwriter.h \
     posterazorcore.h \
+    posterlayout.h \
     snapspinbox.h \
+    tiledimage.h \
+    tiledimagestore.h \
     types.h \
     wizardcontroller.h
 
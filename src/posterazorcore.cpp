@@ -20,6 +20,8 @@
     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 */
 
+#include "pagerasterizer.h"
+#include "passthroughimage.h"
 #include "pdfwriter.h"
 #include "posterazorcore.h"
 #if defined (FREEIMAGE_LIB)
@@ -30,12 +32,35 @@
 
 #include <QBrush>
 #include <QFile>
+#include <QFutureWatcher>
+#include <QGuiApplication>
+#include <QHash>
+#include <QImageWriter>
+#include <QScreen>
 #include <QSettings>
 #include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
 
+#include <algorithm>
 #include <cmath>
 
-const QLatin1String defaultValue_PaperFormat(           "DIN A4");
+const Types::PaperFormats defaultValue_PaperFormat = Types::PaperFormatDinA4;
+
+// The quick preview is shown at once, and is the first level of the PaintCanvas
+// pyramid. The detailed one replaces it, see detailedPreviewBoxSize()
+static const QSize previewBoxSize(1024, 768);
+
+// The largest canvas is a maximized window on the largest screen
+static QSize detailedPreviewBoxSize()
+{
+    QSize result = previewBoxSize;
+    if (qobject_cast<QGuiApplication*>(QCoreApplication::instance()))
+        for (const QScreen *screen : QGuiApplication::screens())
+            result = result.expandedTo(screen->size() * screen->devicePixelRatio());
+    return result;
+}
 
 const QLatin1String settingsKey_PosterSizeMode(         "PosterSizeMode");
 const QLatin1String settingsKey_PosterDimension(        "PosterDimension");
@@ -54,13 +79,64 @@ const QLatin1String settingsKey_OverlappingWidth(       "OverlappingWidth");
 const QLatin1String settingsKey_OverlappingHeight(      "OverlappingHeight");
 const QLatin1String settingsKey_OverlappingPosition(    "OverlappingPosition");
 const QLatin1String settingsKey_UnitOfLength(           "UnitOfLength");
+const QLatin1String settingsKey_CompressionLevel(       "CompressionLevel");
+const QLatin1String settingsKey_CompressionThreadsCount("CompressionThreadsCount");
+const QLatin1String settingsKey_PdfImageMode(           "PdfImageMode");
+const QLatin1String settingsKey_PngPredictor(           "PngPredictor");
+const QLatin1String settingsKey_DeflateBackend(         "DeflateBackend");
+
+// The number of values of the enum settings, which are stored as their index
+static const QHash<QString, int> &enumSettingsCounts()
+{
+    static const QHash<QString, int> counts {
+        {settingsKey_PosterSizeMode,     Types::PosterSizeModeNone + 1},
+        {settingsKey_PaperOrientation,   QPageLayout::Landscape + 1},
+        {settingsKey_UnitOfLength,       Types::UnitsOfLengthCount},
+        {settingsKey_PdfImageMode,       Types::PdfImageModeTiled + 1},
+        {settingsKey_PngPredictor,       Types::PngPredictorAdaptive + 1},
+        {settingsKey_DeflateBackend,     Types::DeflateBackendLibDeflate + 1}
+    };
+    return counts;
+}
+
+static bool isValidEnumSetting(const QVariant &value, int count)
+{
+    bool isNumber = false;
+    const int index = value.toInt(&isNumber);
+    return isNumber && index >= 0 && index < count;
+}
+
+static bool isValidAlignmentSetting(const QVariant &value)
+{
+    bool isNumber = false;
+    const int alignment = value.toInt(&isNumber);
+    return isNumber && (alignment & ~int(Qt::AlignHorizontal_Mask | Qt::AlignVertical_Mask)) == 0;
+}
+
+// Invalid values keep the current one, like missing ones
+static int enumSetting(const QVariantHash &settings, const QString &key, int currentValue)
+{
+    const QVariant value = settings.value(key);
+    return value.isValid() && isValidEnumSetting(value, enumSettingsCounts().value(key)) ? value.toInt() : currentValue;
+}
+
+static int alignmentSetting(const QVariantHash &settings, const QString &key, int currentValue)
+{
+    const QVariant value = settings.value(key);
+    return value.isValid() && isValidAlignmentSetting(value) ? value.toInt() : currentValue;
+}
 
 PosteRazorCore::PosteRazorCore(ImageLoaderInterface *imageLoader, QObject *parent)
     : QObject(parent)
     , m_imageLoader(imageLoader)
-    , m_paperFormat(defaultValue_PaperFormat)
 {
     Q_ASSERT(m_imageLoader);
+    updatePosterLayout();
+}
+
+PosteRazorCore::~PosteRazorCore()
+{
+    waitForDetailedPreviewImages();
 }
 
 unsigned int PosteRazorCore::imageBitsPerLineCount(int widthPixels, int bitPerPixel)
@@ -73,32 +149,120 @@ unsigned int PosteRazorCore::imageBytesPerLineCount(int widthPixels, int bitPerP
     return (int)(ceil((qreal)imageBitsPerLineCount(widthPixels, bitPerPixel) / (qreal)8));
 }
 
-unsigned int PosteRazorCore::imageBytesCount(const QSize &size, int bitPerPixel)
+qint64 PosteRazorCore::imageBytesCount(const QSize &size, int bitPerPixel)
 {
-    return imageBytesPerLineCount(size.width(), bitPerPixel) * size.height();
+    return qint64(imageBytesPerLineCount(size.width(), bitPerPixel)) * size.height();
+}
+
+const QStringList PosteRazorCore::settingsKeys()
+{
+    return {
+        settingsKey_PosterSizeMode,
+        settingsKey_PosterDimension,
+        settingsKey_PosterDimensionIsWidth,
+        settingsKey_PosterAlignment,
+        settingsKey_PaperFormat,
+        settingsKey_PaperOrientation,
+        settingsKey_PaperBorderTop,
+        settingsKey_PaperBorderRight,
+        settingsKey_PaperBorderBottom,
+        settingsKey_PaperBorderLeft,
+        settingsKey_CustomPaperWidth,
+        settingsKey_CustomPaperHeight,
+        settingsKey_UseCustomPaperSize,
+        settingsKey_OverlappingWidth,
+        settingsKey_OverlappingHeight,
+        settingsKey_OverlappingPosition,
+        settingsKey_UnitOfLength,
+        settingsKey_CompressionLevel,
+        settingsKey_CompressionThreadsCount,
+        settingsKey_PdfImageMode,
+        settingsKey_PngPredictor,
+        settingsKey_DeflateBackend
+    };
 }
 
 void PosteRazorCore::readSettings(const QSettings *settings)
 {
-    m_posterSizeMode               = (Types::PosterSizeModes)settings->value(settingsKey_PosterSizeMode, (int)m_posterSizeMode).toInt();
-    m_posterDimension              = settings->value(settingsKey_PosterDimension, m_posterDimension).toDouble();
-    m_posterDimensionIsWidth       = settings->value(settingsKey_PosterDimensionIsWidth, m_posterDimensionIsWidth).toBool();
-    m_posterAlignment              = (Qt::Alignment)settings->value(settingsKey_PosterAlignment, (int)m_posterAlignment).toInt();
-    m_usesCustomPaperSize           = settings->value(settingsKey_UseCustomPaperSize, m_usesCustomPaperSize).toBool();
-    m_paperFormat                  = settings->value(settingsKey_PaperFormat, m_paperFormat).toString();
-    if (!Types::paperFormats().contains(m_paperFormat))
-        m_paperFormat = QLatin1String(defaultValue_PaperFormat);
-    m_paperOrientation             = (QPageLayout::Orientation)settings->value(settingsKey_PaperOrientation, (int)m_paperOrientation).toInt();
-    m_paperBorderTop               = settings->value(settingsKey_PaperBorderTop, m_paperBorderTop).toDouble();
-    m_paperBorderRight             = settings->value(settingsKey_PaperBorderRight, m_paperBorderRight).toDouble();
-    m_paperBorderBottom            = settings->value(settingsKey_PaperBorderBottom, m_paperBorderBottom).toDouble();
-    m_paperBorderLeft              = settings->value(settingsKey_PaperBorderLeft, m_paperBorderLeft).toDouble();
-    m_customPaperWidth             = settings->value(settingsKey_CustomPaperWidth, m_customPaperWidth).toDouble();
-    m_customPaperHeight            = settings->value(settingsKey_CustomPaperHeight, m_customPaperHeight).toDouble();
-    m_overlappingWidth             = settings->value(settingsKey_OverlappingWidth, m_overlappingWidth).toDouble();
-    m_overlappingHeight            = settings->value(settingsKey_OverlappingHeight, m_overlappingHeight).toDouble();
-    m_overlappingPosition          = (Qt::Alignment)settings->value(settingsKey_OverlappingPosition, (int)m_overlappingPosition).toInt();
-    m_unitOfLength                 = (Types::UnitsOfLength)settings->value(settingsKey_UnitOfLength, (int)m_unitOfLength).toInt();
+    QVariantHash values;
+    for (const QString &key : settingsKeys())
+        if (settings->contains(key))
+            values.insert(key, settings->value(key));
+    readSettings(values);
+}
+
+void PosteRazorCore::readSettings(const QVariantHash &settings)
+{
+    m_posterSizeMode               = (Types::PosterSizeModes)enumSetting(settings, settingsKey_PosterSizeMode, m_posterSizeMode);
+    m_posterDimension              = settings.value(settingsKey_PosterDimension, m_posterDimension).toDouble();
+    m_posterDimensionIsWidth       = settings.value(settingsKey_PosterDimensionIsWidth, m_posterDimensionIsWidth).toBool();
+    m_posterAlignment              = (Qt::Alignment)alignmentSetting(settings, settingsKey_PosterAlignment, m_posterAlignment);
+    m_usesCustomPaperSize           = settings.value(settingsKey_UseCustomPaperSize, m_usesCustomPaperSize).toBool();
+    m_paperFormat                  = Types::paperFormatFromString(settings.value(settingsKey_PaperFormat, paperFormat()).toString());
+    if (m_paperFormat == Types::PaperFormatsCount)
+        m_paperFormat = defaultValue_PaperFormat;
+    m_paperOrientation             = (QPageLayout::Orientation)enumSetting(settings, settingsKey_PaperOrientation, m_paperOrientation);
+    m_paperBorderTop               = settings.value(settingsKey_PaperBorderTop, m_paperBorderTop).toDouble();
+    m_paperBorderRight             = settings.value(settingsKey_PaperBorderRight, m_paperBorderRight).toDouble();
+    m_paperBorderBottom            = settings.value(settingsKey_PaperBorderBottom, m_paperBorderBottom).toDouble();
+    m_paperBorderLeft              = settings.value(settingsKey_PaperBorderLeft, m_paperBorderLeft).toDouble();
+    m_customPaperWidth             = settings.value(settingsKey_CustomPaperWidth, m_customPaperWidth).toDouble();
+    m_customPaperHeight            = settings.value(settingsKey_CustomPaperHeight, m_customPaperHeight).toDouble();
+    m_overlappingWidth             = settings.value(settingsKey_OverlappingWidth, m_overlappingWidth).toDouble();
+    m_overlappingHeight            = settings.value(settingsKey_OverlappingHeight, m_overlappingHeight).toDouble();
+    m_overlappingPosition          = (Qt::Alignment)alignmentSetting(settings, settingsKey_OverlappingPosition, m_overlappingPosition);
+    m_unitOfLength                 = (Types::UnitsOfLength)enumSetting(settings, settingsKey_UnitOfLength, m_unitOfLength);
+    m_compressionLevel             = qBound(0, settings.value(settingsKey_CompressionLevel, m_compressionLevel).toInt(), 9);
+    m_compressionThreadsCount      = qMax(0, settings.value(settingsKey_CompressionThreadsCount, m_compressionThreadsCount).toInt());
+    m_pdfImageMode                 = (Types::PdfImageModes)enumSetting(settings, settingsKey_PdfImageMode, m_pdfImageMode);
+    m_pngPredictor                 = (Types::PngPredictors)enumSetting(settings, settingsKey_PngPredictor, m_pngPredictor);
+    m_deflateBackend               = (Types::DeflateBackends)enumSetting(settings, settingsKey_DeflateBackend, m_deflateBackend);
+    updatePosterLayout();
+}
+
+bool PosteRazorCore::checkSettings(const QVariantHash &settings, QString &errorMessage)
+{
+    static const QStringList numberKeys {
+        settingsKey_PosterDimension, settingsKey_PaperBorderTop, settingsKey_PaperBorderRight,
+        settingsKey_PaperBorderBottom, settingsKey_PaperBorderLeft, settingsKey_CustomPaperWidth,
+        settingsKey_CustomPaperHeight, settingsKey_OverlappingWidth, settingsKey_OverlappingHeight,
+        settingsKey_CompressionLevel, settingsKey_CompressionThreadsCount
+    };
+    static const QStringList booleanKeys {
+        settingsKey_PosterDimensionIsWidth, settingsKey_UseCustomPaperSize
+    };
+
+    for (auto it = settings.constBegin(); it != settings.constEnd(); ++it) {
+        const QString &key = it.key();
+        const QVariant &value = it.value();
+        const QString text = value.toString();
+        bool isValid = true;
+        QString expected;
+        if (enumSettingsCounts().contains(key)) {
+            const int count = enumSettingsCounts().value(key);
+            isValid = isValidEnumSetting(value, count);
+            expected = QString::fromLatin1("a number from 0 to %1").arg(count - 1);
+        } else if (key == settingsKey_PosterAlignment || key == settingsKey_OverlappingPosition) {
+            isValid = isValidAlignmentSetting(value);
+            expected = QLatin1String("a combination of Qt::Alignment flags");
+        } else if (key == settingsKey_PaperFormat) {
+            isValid = Types::paperFormatFromString(text) != Types::PaperFormatsCount;
+            expected = QLatin1String("a known paper format");
+        } else if (numberKeys.contains(key)) {
+            text.toDouble(&isValid);
+            expected = QLatin1String("a number");
+        } else if (booleanKeys.contains(key)) {
+            isValid = value.type() == QVariant::Bool
+                || QStringList({QLatin1String("true"), QLatin1String("false"), QLatin1String("1"), QLatin1String("0")})
+                    .contains(text, Qt::CaseInsensitive);
+            expected = QLatin1String("true or false");
+        }
+        if (!isValid) {
+            errorMessage = QString::fromLatin1("The value '%1' of %2 is invalid, it must be %3.").arg(text, key, expected);
+            return false;
+        }
+    }
+    return true;
 }
 
 void PosteRazorCore::writeSettings(QSettings *settings) const
@@ -108,7 +272,7 @@ void PosteRazorCore::writeSettings(QSettings *settings) const
     settings->setValue(settingsKey_PosterDimensionIsWidth, m_posterDimensionIsWidth);
     settings->setValue(settingsKey_PosterAlignment, (int)m_posterAlignment);
     settings->setValue(settingsKey_UseCustomPaperSize, m_usesCustomPaperSize);
-    settings->setValue(settingsKey_PaperFormat, m_paperFormat);
+    settings->setValue(settingsKey_PaperFormat, paperFormat());
     settings->setValue(settingsKey_PaperOrientation, (int)m_paperOrientation);
     settings->setValue(settingsKey_PaperBorderTop, m_paperBorderTop);
     settings->setValue(settingsKey_PaperBorderRight, m_paperBorderRight);
@@ -120,6 +284,11 @@ void PosteRazorCore::writeSettings(QSettings *settings) const
     settings->setValue(settingsKey_OverlappingHeight, m_overlappingHeight);
     settings->setValue(settingsKey_OverlappingPosition, (int)m_overlappingPosition);
     settings->setValue(settingsKey_UnitOfLength, (int)m_unitOfLength);
+    settings->setValue(settingsKey_CompressionLevel, m_compressionLevel);
+    settings->setValue(settingsKey_CompressionThreadsCount, m_compressionThreadsCount);
+    settings->setValue(settingsKey_PdfImageMode, (int)m_pdfImageMode);
+    settings->setValue(settingsKey_PngPredictor, (int)m_pngPredictor);
+    settings->setValue(settingsKey_DeflateBackend, (int)m_deflateBackend);
 }
 
 qreal PosteRazorCore::convertDistanceToCm(qreal distance) const
@@ -144,12 +313,60 @@ QSizeF PosteRazorCore::convertCmToSize(const QSizeF &sizeInCm) const
 
 bool PosteRazorCore::loadInputImage(const QString &imageFileName, QString &errorMessage)
 {
+    // The image is replaced in place
+    waitForDetailedPreviewImages();
     const bool success = m_imageLoader->loadInputImage(imageFileName, errorMessage);
-    if (success)
+    updatePosterLayout();
+    if (success && m_previewImageEnabled)
         createPreviewImage();
     return success;
 }
 
+ImageLoaderInterface *PosteRazorCore::createImageLoader() const
+{
+    return m_imageLoader->create();
+}
+
+QImage PosteRazorCore::readPreviewImage(const ImageLoaderInterface *imageLoader, const QString &imageFileName) const
+{
+    return imageLoader->readPreviewImage(imageFileName, previewBoxSize);
+}
+
+bool PosteRazorCore::loadInputImage(ImageLoaderInterface *imageLoader, const QString &imageFileName, QString &errorMessage,
+                                    QImage &previewImage, const std::atomic<bool> &canceled) const
+{
+    // The decoding itself can not be interrupted. But a canceled image gets no preview
+    if (canceled || !imageLoader->loadInputImage(imageFileName, errorMessage) || canceled)
+        return false;
+    if (m_previewImageEnabled)
+        previewImage = this->previewImage(imageLoader, previewBoxSize);
+    return !canceled;
+}
+
+void PosteRazorCore::setInputImage(ImageLoaderInterface *imageLoader, const QImage &previewImage)
+{
+    m_ownedImageLoader.reset(imageLoader);
+    m_imageLoader = imageLoader;
+    m_loadingPreviewImageSize = QSize();
+    updatePosterLayout();
+    if (m_previewImageEnabled) {
+        emit previewImageChanged(previewImage);
+        createDetailedPreviewImage();
+    }
+}
+
+void PosteRazorCore::setLoadingPreviewImage(const QImage &previewImage)
+{
+    const bool wasLoading = !m_loadingPreviewImageSize.isEmpty();
+    m_loadingPreviewImageSize = previewImage.size();
+    if (!previewImage.isNull()) {
+        m_previewImageGeneration++;
+        emit previewImageChanged(previewImage);
+    }
+    else if (wasLoading && isImageLoaded() && m_previewImageEnabled)
+        createPreviewImage();
+}
+
 QString PosteRazorCore::fileName() const
 {
     return m_imageLoader->fileName();
@@ -217,37 +434,45 @@ Types::UnitsOfLength PosteRazorCore::unitOfLength() const
 
 void PosteRazorCore::setPaperFormat(const QString &format)
 {
-    m_paperFormat = format;
+    m_paperFormat = Types::paperFormatFromString(format);
+    if (m_paperFormat == Types::PaperFormatsCount)
+        m_paperFormat = defaultValue_PaperFormat;
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setPaperOrientation(QPageLayout::Orientation orientation)
 {
     m_paperOrientation = orientation;
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setPaperBorderTop(qreal border)
 {
     m_paperBorderTop = convertDistanceToCm(border);
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setPaperBorderRight(qreal border)
 {
     m_paperBorderRight = convertDistanceToCm(border);
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setPaperBorderBottom(qreal border)
 {
     m_paperBorderBottom = convertDistanceToCm(border);
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setPaperBorderLeft(qreal border)
 {
     m_paperBorderLeft = convertDistanceToCm(border);
+    updatePosterLayout();
 }
 
 const QString PosteRazorCore::paperFormat() const
 {
-    return m_paperFormat;
+    return QLatin1String(Types::paperFormatTable[m_paperFormat].name);
 }
 
 QPageLayout::Orientation PosteRazorCore::paperOrientation() const
@@ -288,11 +513,13 @@ qreal PosteRazorCore::maximalHorizontalPaperBorder() const
 void PosteRazorCore::setCustomPaperWidth(qreal width)
 {
     m_customPaperWidth = convertDistanceToCm(width);
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setCustomPaperHeight(qreal height)
 {
     m_customPaperHeight = convertDistanceToCm(height);
+    updatePosterLayout();
 }
 
 QSizeF PosteRazorCore::customPaperSize() const
@@ -310,6 +537,7 @@ QSizeF PosteRazorCore::customPaperSize() const
 void PosteRazorCore::setUseCustomPaperSize(bool useIt)
 {
     m_usesCustomPaperSize = useIt;
+    updatePosterLayout();
 }
 
 bool PosteRazorCore::usesCustomPaperSize() const
@@ -320,7 +548,7 @@ bool PosteRazorCore::usesCustomPaperSize() const
 QSizeF PosteRazorCore::paperSize() const
 {
     return usesCustomPaperSize() ? customPaperSize()
-        : Types::paperSize(paperFormat(), paperOrientation(), m_unitOfLength);
+        : Types::paperSize(m_paperFormat, paperOrientation(), m_unitOfLength);
 }
 
 QSizeF PosteRazorCore::printablePaperAreaSize() const
@@ -400,23 +628,26 @@ qreal PosteRazorCore::calculateOtherPosterDimension() const
 
 void PosteRazorCore::setPosterDimension(Types::PosterSizeModes mode, qreal dimension, bool dimensionIsWidth)
 {
-    setPosterSizeMode(mode);
+    m_posterSizeMode = mode;
 
     if (posterSizeMode() == Types::PosterSizeModeAbsolute)
         dimension = convertDistanceToCm(dimension);
 
     m_posterDimension = dimension;
     m_posterDimensionIsWidth = dimensionIsWidth;
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setOverlappingWidth(qreal width)
 {
     m_overlappingWidth = convertDistanceToCm(width);
+    updatePosterLayout();
 }
 
 void PosteRazorCore::setOverlappingHeight(qreal height)
 {
     m_overlappingHeight = convertDistanceToCm(height);
+    updatePosterLayout();
 }
 
 qreal PosteRazorCore::overlappingWidth() const
@@ -462,6 +693,7 @@ void PosteRazorCore::setPosterHeight(Types::PosterSizeModes mode, qreal height)
 void PosteRazorCore::setPosterSizeMode(Types::PosterSizeModes mode)
 {
     m_posterSizeMode = mode;
+    updatePosterLayout();
 }
 
 qreal PosteRazorCore::posterDimension(Types::PosterSizeModes mode, bool width) const
@@ -512,11 +744,105 @@ Types::PosterSizeModes PosteRazorCore::posterSizeMode() const
 void PosteRazorCore::setPosterAlignment(Qt::Alignment alignment)
 {
     m_posterAlignment = alignment;
+    updatePosterLayout();
+}
+
+void PosteRazorCore::setCompressionLevel(int level)
+{
+    m_compressionLevel = qBound(0, level, 9);
+}
+
+int PosteRazorCore::compressionLevel() const
+{
+    return m_compressionLevel;
+}
+
+void PosteRazorCore::setCompressionThreadsCount(int count)
+{
+    m_compressionThreadsCount = qMax(0, count);
+}
+
+int PosteRazorCore::compressionThreadsCount() const
+{
+    return m_compressionThreadsCount;
+}
+
+void PosteRazorCore::setPdfImageMode(Types::PdfImageModes mode)
+{
+    m_pdfImageMode = mode;
+}
+
+Types::PdfImageModes PosteRazorCore::pdfImageMode() const
+{
+    return m_pdfImageMode;
+}
+
+void PosteRazorCore::setPngPredictor(Types::PngPredictors predictor)
+{
+    m_pngPredictor = predictor;
+}
+
+Types::PngPredictors PosteRazorCore::pngPredictor() const
+{
+    return m_pngPredictor;
+}
+
+void PosteRazorCore::setDeflateBackend(Types::DeflateBackends backend)
+{
+    m_deflateBackend = backend;
+}
+
+Types::DeflateBackends PosteRazorCore::deflateBackend() const
+{
+    return m_deflateBackend;
+}
+
+void PosteRazorCore::setPreviewImageEnabled(bool enabled)
+{
+    m_previewImageEnabled = enabled;
 }
 
 void PosteRazorCore::createPreviewImage()
 {
-    createPreviewImage(QSize(1024, 768));
+    createPreviewImage(previewBoxSize);
+    createDetailedPreviewImage();
+}
+
+// Built on a worker thread from the loader, which the owning pointer keeps
+// alive if another image replaces it meanwhile.
+void PosteRazorCore::createDetailedPreviewImage()
+{
+    const int generation = ++m_previewImageGeneration;
+    const QSize boxSize = detailedPreviewBoxSize();
+    if (!isImageLoaded() || (boxSize.width() <= previewBoxSize.width() && boxSize.height() <= previewBoxSize.height()))
+        return;
+
+    const std::shared_ptr<ImageLoaderInterface> ownedImageLoader = m_ownedImageLoader;
+    const ImageLoaderInterface *imageLoader = m_imageLoader;
+    const QFuture<QImage> future = QtConcurrent::run([ownedImageLoader, imageLoader, boxSize] {
+        return previewImage(ownedImageLoader ? ownedImageLoader.get() : imageLoader, boxSize);
+    });
+    auto end = std::remove_if(m_detailedPreviewImages.begin(), m_detailedPreviewImages.end(),
+                              [] (const QFuture<QImage> &image) { return image.isFinished(); });
+    m_detailedPreviewImages.erase(end, m_detailedPreviewImages.end());
+    m_detailedPreviewImages.append(future);
+
+    auto watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, generation] {
+        const QImage image = watcher->result();
+        watcher->deleteLater();
+        if (generation == m_previewImageGeneration && !image.isNull())
+            emit previewImageChanged(image);
+    });
+    watcher->setFuture(future);
+}
+
+// The loader which is not owned is not kept alive by the preview threads
+void PosteRazorCore::waitForDetailedPreviewImages()
+{
+    for (QFuture<QImage> &image : m_detailedPreviewImages)
+        image.waitForFinished();
+    m_detailedPreviewImages.clear();
 }
 
 Qt::Alignment PosteRazorCore::posterAlignment() const
@@ -524,7 +850,31 @@ Qt::Alignment PosteRazorCore::posterAlignment() const
     return m_posterAlignment;
 }
 
-QSizeF PosteRazorCore::previewSize(const QSizeF &imageSize, const QSize &boxSize, bool enlargeToFit) const
+const PosterLayout &PosteRazorCore::posterLayout() const
+{
+    return m_posterLayout;
+}
+
+void PosteRazorCore::updatePosterLayout()
+{
+    // Without an image, the poster size is undefined
+    if (!isImageLoaded()) {
+        m_posterLayout = PosterLayout();
+        return;
+    }
+    m_posterLayout = PosterLayout(
+        m_imageLoader->sizePixels(),
+        convertSizeToCm(posterSize(Types::PosterSizeModeAbsolute)),
+        posterSize(Types::PosterSizeModePages),
+        convertSizeToCm(printablePaperAreaSize()),
+        convertSizeToCm(QSizeF(overlappingWidth(), overlappingHeight())),
+        QMarginsF(convertDistanceToCm(paperBorderLeft()), convertDistanceToCm(paperBorderTop()),
+                  convertDistanceToCm(paperBorderRight()), convertDistanceToCm(paperBorderBottom())),
+        posterAlignment()
+    );
+}
+
+QSizeF PosteRazorCore::previewSize(const QSizeF &imageSize, const QSize &boxSize, bool enlargeToFit)
 {
     QSizeF result(imageSize);
 
@@ -536,23 +886,35 @@ QSizeF PosteRazorCore::previewSize(const QSizeF &imageSize, const QSize &boxSize
     return result;
 }
 
-QSizeF PosteRazorCore::inputImagePreviewSize(const QSize &boxSize) const
+void PosteRazorCore::createPreviewImage(const QSize &size) const
 {
-    return previewSize(inputImageSizePixels(), boxSize, false);
+    emit previewImageChanged(previewImage(m_imageLoader, size));
 }
 
-void PosteRazorCore::createPreviewImage(const QSize &size) const
+QImage PosteRazorCore::previewImage(const ImageLoaderInterface *imageLoader, const QSize &boxSize)
 {
-    const QImage previewImage = m_imageLoader->imageAsRGB(inputImagePreviewSize(size).toSize());
-    emit previewImageChanged(previewImage);
+    const QSize size = previewSize(imageLoader->sizePixels(), boxSize, false).toSize();
+
+    // Decoding a JPEG at 1/2, 1/4 or 1/8 of its size is an order of magnitude
+    // quicker than scaling down all of its pixels
+    if (imageLoader->isJpeg()) {
+        const QImage scaledImage = imageLoader->readPreviewImage(imageLoader->fileName(), size);
+        if (!scaledImage.isNull())
+            return scaledImage.size() == size ? scaledImage
+                : scaledImage.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    return imageLoader->imageAsRGB(size);
 }
 
 void PosteRazorCore::paintImageOnCanvas(PaintCanvasInterface *paintCanvas) const
 {
-    if (isImageLoaded()) {
+    const bool isLoading = !m_loadingPreviewImageSize.isEmpty();
+    if (isImageLoaded() || isLoading) {
         const QSizeF canvasSize = paintCanvas->size();
-        const QSize inputImageSize = inputImageSizePixels();
-        const QSizeF boxSize = previewSize(inputImageSize, canvasSize.toSize(), false);
+        const QSize inputImageSize = isLoading ? m_loadingPreviewImageSize : inputImageSizePixels();
+        // A thumbnail stands in for a larger image
+        const QSizeF boxSize = previewSize(inputImageSize, canvasSize.toSize(), isLoading);
         QPointF offset((canvasSize.width() - boxSize.width()) / 2, (canvasSize.height() - boxSize.height()) / 2);
 
         // If the image is not downscaled, make sure that the coordinates are integers in order
@@ -599,64 +961,38 @@ void PosteRazorCore::paintPaperOnCanvas(PaintCanvasInterface *paintCanvas, bool
 
 void PosteRazorCore::paintPosterOnCanvasOverlapped(PaintCanvasInterface *paintCanvas) const
 {
+    const PosterLayout &layout = m_posterLayout;
+    const int pagesHorizontal = layout.columnsCount();
+    const int pagesVertical = layout.rowsCount();
     const QSizeF canvasSize = paintCanvas->size();
-    QSizeF pagePrintableAreaSize = printablePaperAreaSize();
-    const QSizeF posterSizePages = posterSize(Types::PosterSizeModePages);
-    const int pagesHorizontal = (int)ceil(posterSizePages.width());
-    const int pagesVertical = (int)ceil(posterSizePages.height());
-    const QSizeF posterSize(
-        pagesHorizontal*pagePrintableAreaSize.width() - (pagesHorizontal-1)*overlappingWidth() + paperBorderLeft() + paperBorderRight(),
-        pagesVertical*pagePrintableAreaSize.height() - (pagesVertical-1)*overlappingHeight() + paperBorderTop() + paperBorderBottom()
-    );
+    const QSizeF posterSize = layout.posterSizeCm();
     const QSizeF boxSize = previewSize(posterSize, canvasSize.toSize(), true);
     const QPointF offset((canvasSize.width() - boxSize.width()) / 2, (canvasSize.height() - boxSize.height()) / 2);
-    const qreal UnitOfLengthToPixelfactor = boxSize.width()/posterSize.width();
+    const qreal cmToPixelFactor = boxSize.width()/posterSize.width();
 
-    const qreal borderTop = paperBorderTop() * UnitOfLengthToPixelfactor;
-    const qreal borderRight = paperBorderRight() * UnitOfLengthToPixelfactor;
-    const qreal borderBottom = paperBorderBottom() * UnitOfLengthToPixelfactor;
-    const qreal borderLeft = paperBorderLeft() * UnitOfLengthToPixelfactor;
-    const QSizeF posterPrintableAreaSize(boxSize.width() - borderLeft - borderRight, boxSize.height() - borderTop - borderBottom);
-    const QPointF posterPrintableAreaOrigin = QPointF(borderLeft, borderTop) + offset;
+    const QMarginsF borders = layout.paperBordersCm() * cmToPixelFactor;
+    const QSizeF posterPrintableAreaSize(boxSize.width() - borders.left() - borders.right(), boxSize.height() - borders.top() - borders.bottom());
+    const QPointF posterPrintableAreaOrigin = QPointF(borders.left(), borders.top()) + offset;
     const QRectF posterPrintableArea(posterPrintableAreaOrigin, posterPrintableAreaSize);
 
     paintCanvas->drawFilledRect(QRectF(offset, boxSize), QColor(128, 128, 128));
     paintCanvas->drawFilledRect(posterPrintableArea, QColor(230, 230, 230));
 
-    const QSizeF posterSizeAbsolute = this->posterSize(Types::PosterSizeModeAbsolute);
-    const QSizeF imageSize = posterSizeAbsolute * UnitOfLengthToPixelfactor;
-    const Qt::Alignment alignment = posterAlignment();
-
-    paintCanvas->drawImage(
-        QRectF(
-            QPointF(
-                (
-                    (alignment & Qt::AlignLeft) ? borderLeft
-                    : (alignment & Qt::AlignHCenter) ? qBound(borderLeft, (boxSize.width() - imageSize.width()) / 2, borderLeft + posterPrintableAreaSize.width() - imageSize.width())
-                    : (borderLeft + posterPrintableAreaSize.width() - imageSize.width())
-                ) + offset.x(),
-                (
-                    (alignment & Qt::AlignTop) ? borderTop
-                    : (alignment & Qt::AlignVCenter) ? qBound(borderTop, (boxSize.height() - imageSize.height()) / 2, borderTop + posterPrintableAreaSize.height() - imageSize.height())
-                    : (borderTop + posterPrintableAreaSize.height() - imageSize.height())
-                ) + offset.y()
-            ),
-            imageSize
-        )
-    );
+    paintCanvas->drawImage(QRectF(posterPrintableAreaOrigin + layout.imageOffsetCm() * cmToPixelFactor,
+                                  layout.imageSizeCm() * cmToPixelFactor));
 
-    const qreal overlappingHeight = this->overlappingHeight() * UnitOfLengthToPixelfactor;
-    const qreal overlappingWidth = this->overlappingWidth() * UnitOfLengthToPixelfactor;
-    pagePrintableAreaSize *= UnitOfLengthToPixelfactor;
+    const qreal overlappingHeight = layout.overlappingSizeCm().height() * cmToPixelFactor;
+    const qreal overlappingWidth = layout.overlappingSizeCm().width() * cmToPixelFactor;
+    const QSizeF pagePrintableAreaSize = layout.printablePaperAreaSizeCm() * cmToPixelFactor;
 
     const QColor overlappingColor(255, 128, 128, 128);
-    qreal overlappingRectangleYPosition = borderTop;
+    qreal overlappingRectangleYPosition = borders.top();
     for (int pagesRow = 0; pagesRow < pagesVertical - 1; pagesRow++) {
         overlappingRectangleYPosition += pagePrintableAreaSize.height() - overlappingHeight;
         paintCanvas->drawFilledRect(QRectF(QPointF(0, overlappingRectangleYPosition) + offset, QSizeF(boxSize.width(), overlappingHeight)), overlappingColor);
     }
 
-    qreal overlappingRectangleXPosition = borderLeft;
+    qreal overlappingRectangleXPosition = borders.left();
     for (int pagesColumn = 0; pagesColumn < pagesHorizontal - 1; pagesColumn++) {
         overlappingRectangleXPosition += pagePrintableAreaSize.width() - overlappingWidth;
         paintCanvas->drawFilledRect(QRectF(QPointF(overlappingRectangleXPosition, 0) + offset, QSizeF(overlappingWidth, boxSize.height())), overlappingColor);
@@ -694,104 +1030,199 @@ void PosteRazorCore::paintPosterOnCanvasPageWise(PaintCanvasInterface *paintCanv
 
 void PosteRazorCore::paintPosterPageOnCanvas(PaintCanvasInterface *paintCanvas, int page) const
 {
-    const QSizeF posterSizePages = posterSize(Types::PosterSizeModePages);
-    const int columsCount = (int)(ceil(posterSizePages.width()));
-    const int rowsCount = (int)(ceil(posterSizePages.height()));
-    const int column = page % columsCount;
-    const int row = page / columsCount;
-
-    const QSizeF posterSizeAbsolute = posterSize(Types::PosterSizeModeAbsolute);
-    const QSizeF posterImageSizeCm = convertSizeToCm(posterSizeAbsolute);
-    const QSizeF printablePaperAreaSizeCm = convertSizeToCm(printablePaperAreaSize());
-    const qreal overlappingWidthCm = convertDistanceToCm(overlappingWidth());
-    const qreal overlappingHeightCm = convertDistanceToCm(overlappingHeight());
-    const QSizeF printablePosterAreaSizeCm(
-        columsCount * printablePaperAreaSizeCm.width() - (columsCount - 1) * overlappingWidthCm,
-        rowsCount * printablePaperAreaSizeCm.height() - (rowsCount - 1) * overlappingHeightCm
-    );
-    const qreal borderTopCm = convertDistanceToCm(paperBorderTop());
-    const qreal borderRightCm = convertDistanceToCm(paperBorderRight());
-    const qreal borderBottomCm = convertDistanceToCm(paperBorderBottom());
-    const qreal borderLeftCm = convertDistanceToCm(paperBorderLeft());
-    const QSizeF posterTotalSizeCm(
-        printablePosterAreaSizeCm.width() + borderLeftCm + borderRightCm,
-        printablePosterAreaSizeCm.height() + borderTopCm + borderBottomCm
-    );
-    const Qt::Alignment alignment = posterAlignment();
-    qreal imageOffsetFromLeftPosterBorderCm = (
-        (alignment & Qt::AlignRight) ? posterTotalSizeCm.width() - posterImageSizeCm.width() - borderLeftCm
-        : (alignment & Qt::AlignHCenter) ? (posterTotalSizeCm.width() - posterImageSizeCm.width()) / 2 - borderLeftCm
-        : -borderLeftCm
-    );
-    imageOffsetFromLeftPosterBorderCm = qBound(.0, imageOffsetFromLeftPosterBorderCm, posterTotalSizeCm.width() - posterImageSizeCm.width() - borderLeftCm - borderRightCm);
-    qreal imageOffsetFromTopPosterBorderCm = (
-        (alignment & Qt::AlignBottom) ? posterTotalSizeCm.height() - posterImageSizeCm.height() - borderTopCm
-        : (alignment & Qt::AlignVCenter) ? (posterTotalSizeCm.height() - posterImageSizeCm.height()) / 2 - borderTopCm
-        : -borderTopCm
-    );
-    imageOffsetFromTopPosterBorderCm = qBound(.0, imageOffsetFromTopPosterBorderCm, posterTotalSizeCm.height() - posterImageSizeCm.height() - borderTopCm - borderBottomCm);
-    const QPointF pageOffsetToImageFromTopLeftCm(
-        column * (printablePaperAreaSizeCm.width()- overlappingWidthCm) - imageOffsetFromLeftPosterBorderCm,
-        row * (printablePaperAreaSizeCm.height() - overlappingHeightCm) - imageOffsetFromTopPosterBorderCm
-    );
-    paintCanvas->drawImage(QRectF(-pageOffsetToImageFromTopLeftCm, posterImageSizeCm));
+    paintCanvas->drawImagePart(m_posterLayout.pageImageRectCm(page), m_posterLayout.pageSourceRectPixels(page));
+}
+
+PosteRazorCore::PaintRequest PosteRazorCore::paintRequest(const QString &state)
+{
+    PaintRequest request;
+    const QStringList options = state.split(QLatin1Char(' '));
+    const QString &name = options.first();
+    bool pageIsValid = true;
+
+    if (options.count() == 1 && name == QLatin1String("image")) {
+        request.mode = PaintModeImage;
+    } else if (options.count() == 1 && (name == QLatin1String("paper") || name == QLatin1String("overlapping"))) {
+        request.mode = PaintModePaper;
+        if (name == QLatin1String("overlapping"))
+            request.flags |= PaintFlagOverlapping;
+    } else if (options.count() == 2 && name == QLatin1String("posterpage")) {
+        request.mode = PaintModePosterPage;
+        request.page = options.at(1).toInt(&pageIsValid);
+    } else if (options.count() == 2 && name == QLatin1String("poster") && options.at(1) == QLatin1String("overlapped")) {
+        request.mode = PaintModePosterOverlapped;
+    } else if (options.count() == 2 && name == QLatin1String("poster") && options.at(1) == QLatin1String("divided")) {
+        request.mode = PaintModePosterDivided;
+    } else if (options.count() == 3 && name == QLatin1String("poster") && options.at(1) == QLatin1String("pagewise")) {
+        request.mode = PaintModePosterPageWise;
+        request.page = options.at(2).toInt(&pageIsValid);
+    }
+
+    if (!pageIsValid)
+        request.mode = PaintModeInvalid;
+    return request;
 }
 
 void PosteRazorCore::paintOnCanvas(PaintCanvasInterface *paintCanvas, const QVariant &options) const
 {
     const QString state = options.toString();
+    const PaintRequest request = paintRequest(state);
+    if (request.mode == PaintModeInvalid)
+        qWarning("PosteRazorCore::paintOnCanvas(): Unknown state \"%s\".", qPrintable(state));
+    else
+        paintOnCanvas(paintCanvas, request);
+}
 
-    if (state == QLatin1String("image")) {
+void PosteRazorCore::paintOnCanvas(PaintCanvasInterface *paintCanvas, const PaintRequest &request) const
+{
+    // The poster of the previous image would not fit to the preview of the loading one
+    const bool isLoading = !m_loadingPreviewImageSize.isEmpty();
+
+    switch (request.mode) {
+    case PaintModeImage:
         paintImageOnCanvas(paintCanvas);
-    } else if (state == QLatin1String("paper") || state == QLatin1String("overlapping")) {
-        paintPaperOnCanvas(paintCanvas, state == QLatin1String("overlapping"));
-    } else if (state.startsWith(QLatin1String("posterpage"))) {
-        const int page = state.split(QLatin1Char(' ')).last().toInt();
-        paintPosterPageOnCanvas(paintCanvas, page);
-    } else if (state.startsWith(QLatin1String("poster"))) {
-        const QStringList options = state.split(QLatin1Char(' '));
-        if (options.at(1) == QLatin1String("overlapped")) {
+        break;
+    case PaintModePaper:
+        paintPaperOnCanvas(paintCanvas, request.flags & PaintFlagOverlapping);
+        break;
+    case PaintModePosterOverlapped:
+        if (isLoading)
+            paintImageOnCanvas(paintCanvas);
+        else
             paintPosterOnCanvasOverlapped(paintCanvas);
-        } else if (options.at(1) == QLatin1String("divided")) {
+        break;
+    case PaintModePosterDivided:
+        if (isLoading)
+            paintImageOnCanvas(paintCanvas);
+        else
             paintPosterOnCanvasDivided(paintCanvas);
-        } else if (options.at(1) == QLatin1String("pagewise")) {
-            const int page = options.at(2).toInt();
-            paintPosterOnCanvasPageWise(paintCanvas, page);
-        } else {
-            qFatal("Unimplemented poster mode in PosteRazorCore::paintOnCanvas().");
-        }
-    } else {
-        qFatal("Unimplemented state in PosteRazorCore::paintOnCanvas().");
+        break;
+    case PaintModePosterPageWise:
+        if (isLoading)
+            paintImageOnCanvas(paintCanvas);
+        else
+            paintPosterOnCanvasPageWise(paintCanvas, request.page);
+        break;
+    case PaintModePosterPage:
+        paintPosterPageOnCanvas(paintCanvas, request.page);
+        break;
+    case PaintModeInvalid:
+        break;
     }
 }
 
-int PosteRazorCore::savePoster(QIODevice *outputDevice) const
+int PosteRazorCore::savePoster(QIODevice *outputDevice, const Types::SavingProgressHandler &progressHandler) const
 {
     int err = 0;
 
-    const QSizeF posterSizePages = posterSize(Types::PosterSizeModePages);
-    const QSizeF sizeCm = convertSizeToCm(printablePaperAreaSize());
-    const int pagesCount = (int)(ceil(posterSizePages.width())) * (int)(ceil(posterSizePages.height()));
-    const QSize imageSize = m_imageLoader->sizePixels();
-    const QByteArray imageData = m_imageLoader->bits();
+    const QSizeF sizeCm = m_posterLayout.printablePaperAreaSizeCm();
+    const int pagesCount = m_posterLayout.pagesCount();
+    const QSize imageSize = m_posterLayout.imageSizePixels();
 
     PDFWriter pdfWriter;
+    pdfWriter.setCompressionLevel(m_compressionLevel);
+    pdfWriter.setCompressionThreadsCount(m_compressionThreadsCount > 0 ? m_compressionThreadsCount : QThread::idealThreadCount());
+    pdfWriter.setImageMode(m_pdfImageMode);
+    pdfWriter.setPngPredictor(m_pngPredictor);
+    pdfWriter.setDeflateBackend(m_deflateBackend);
+    pdfWriter.setProgressHandler(progressHandler);
     err = pdfWriter.startSaving(outputDevice, pagesCount, sizeCm.width(), sizeCm.height());
     if (!err) {
-        if (m_imageLoader->isJpeg())
-            err = pdfWriter.saveJpegImage(m_imageLoader->fileName(), imageSize, m_imageLoader->colorDataType());
-        else
-            err = pdfWriter.saveImage(imageData, imageSize, m_imageLoader->bitsPerPixel(), m_imageLoader->colorDataType(), m_imageLoader->colorTable());
+        if (m_imageLoader->isJpeg()) {
+            err = pdfWriter.saveJpegImage(*m_imageLoader->jpegFile(), imageSize, m_imageLoader->colorDataType());
+        } else if (const PassthroughImage *passthroughImage = m_imageLoader->passthroughImage()) {
+            err = pdfWriter.savePassthroughImage(*passthroughImage);
+        } else {
+            // The PDFWriter pulls the rows while compressing, instead of a copy of the whole image
+            const ImageLoaderInterface *imageLoader = m_imageLoader;
+            err = pdfWriter.saveImage([imageLoader] (int firstRow, int rowsCount, char *destination) {
+                    imageLoader->readScanlines(firstRow, rowsCount, destination);
+                }, imageSize, m_imageLoader->bitsPerPixel(), m_imageLoader->colorDataType(), m_imageLoader->colorTable());
+        }
     }
 
-    if (!err) {
-        for (int page = 0; page < pagesCount; page++) {
-            pdfWriter.startPage();
-            paintOnCanvas(&pdfWriter, QString::fromLatin1("posterpage %1").arg(page));
-            pdfWriter.finishPage();
-        }
+    for (int page = 0; page < pagesCount && !err; page++) {
+        pdfWriter.startPage();
+        PaintRequest request;
+        request.mode = PaintModePosterPage;
+        request.page = page;
+        paintOnCanvas(&pdfWriter, request);
+        err = pdfWriter.finishPage();
+        if (!err && progressHandler && !progressHandler(Types::SavingStagePages, page + 1, pagesCount))
+            err = Types::savingCanceledError;
+    }
+
+    if (!err)
         err = pdfWriter.finishSaving();
+
+    return err;
+}
+
+QString PosteRazorCore::posterPageFileName(const QString &baseFileName, Types::PageImageFormats format, int page, int pagesCount)
+{
+    // Zero padded, so that the files sort by page
+    const int digitsCount = QString::number(pagesCount).length();
+    return QString::fromLatin1("%1-%2.%3")
+        .arg(baseFileName)
+        .arg(page + 1, digitsCount, 10, QLatin1Char('0'))
+        .arg(QLatin1String(format == Types::PageImageFormatTiff ? "tif" : "png"));
+}
+
+int PosteRazorCore::savePosterPages(const QString &baseFileName, Types::PageImageFormats format, qreal dpi,
+                                    const Types::SavingProgressHandler &progressHandler) const
+{
+    const int pagesCount = m_posterLayout.pagesCount();
+    if (pagesCount == 0 || dpi <= 0)
+        return Types::savingPageImageError;
+
+    // Each page gets rendered and encoded on a thread of its own. Only as many
+    // pages as there are threads are held in memory at once
+    const int threadsCount = m_compressionThreadsCount > 0 ? m_compressionThreadsCount : QThread::idealThreadCount();
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(qMin(threadsCount, pagesCount));
+    std::atomic<bool> canceled(false);
+    // Set by each task for its own page only, before the file is touched
+    QVector<bool> writtenPages(pagesCount, false);
+    bool *writtenPage = writtenPages.data();
+
+    QVector<QFuture<int> > pageResults;
+    pageResults.reserve(pagesCount);
+    for (int page = 0; page < pagesCount; page++) {
+        pageResults.append(QtConcurrent::run(&threadPool, [this, &canceled, writtenPage, baseFileName, format, dpi, page, pagesCount] () -> int {
+            if (canceled)
+                return Types::savingCanceledError;
+            PageRasterizer pageRasterizer(m_imageLoader, m_posterLayout.printablePaperAreaSizeCm(), dpi);
+            if (pageRasterizer.image().isNull())
+                return Types::savingPageImageError;
+            PaintRequest request;
+            request.mode = PaintModePosterPage;
+            request.page = page;
+            paintOnCanvas(&pageRasterizer, request);
+            QImageWriter writer(posterPageFileName(baseFileName, format, page, pagesCount),
+                                format == Types::PageImageFormatTiff ? "tiff" : "png");
+            writtenPage[page] = true;
+            return writer.write(pageRasterizer.image()) ? 0 : Types::savingPageImageError;
+        }));
     }
 
+    // The progress is reported from this thread, in the order of the pages
+    int err = 0;
+    for (int page = 0; page < pagesCount; page++) {
+        const int pageErr = pageResults.at(page).result();
+        if (!err && pageErr)
+            err = pageErr;
+        if (!err && progressHandler && !progressHandler(Types::SavingStagePages, page + 1, pagesCount))
+            err = Types::savingCanceledError;
+        if (err)
+            canceled = true;
+    }
+
+    // No incomplete set of pages is left behind. Files which this call did
+    // not write are none of its business.
+    if (err)
+        for (int page = 0; page < pagesCount; page++)
+            if (writtenPages.at(page))
+                QFile::remove(posterPageFileName(baseFileName, format, page, pagesCount));
+
     return err;
 }
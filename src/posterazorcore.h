@@ -24,7 +24,16 @@
 
 #include "types.h"
 #include "paintcanvasinterface.h"
+#include "posterlayout.h"
+#include <QFuture>
+#include <QImage>
 #include <QObject>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
 
 QT_BEGIN_NAMESPACE
 class QSettings;
@@ -37,16 +46,57 @@ class PosteRazorCore: public QObject
     Q_OBJECT
 
 public:
+    // What paintOnCanvas() paints. The string states of the PaintCanvas are parsed into this
+    enum PaintModes {
+        PaintModeImage,             // "image"
+        PaintModePaper,             // "paper", or "overlapping" with PaintFlagOverlapping
+        PaintModePosterOverlapped,  // "poster overlapped"
+        PaintModePosterDivided,     // "poster divided"
+        PaintModePosterPageWise,    // "poster pagewise <page>"
+        PaintModePosterPage,        // "posterpage <page>", a page as it is printed
+        PaintModeInvalid
+    };
+
+    enum PaintFlags {
+        PaintFlagOverlapping = 0x1  // Also paints the overlapping area of the paper
+    };
+
+    struct PaintRequest {
+        PaintModes mode = PaintModeInvalid;
+        int page = 0;
+        int flags = 0;
+    };
+
     PosteRazorCore(ImageLoaderInterface *imageLoader, QObject *parent = nullptr);
+    ~PosteRazorCore() override;
 
     static unsigned int imageBitsPerLineCount(int widthPixels, int bitPerPixel);
     static unsigned int imageBytesPerLineCount(int widthPixels, int bitPerPixel);
-    static unsigned int imageBytesCount(const QSize &size, int bitPerPixel);
+    static qint64 imageBytesCount(const QSize &size, int bitPerPixel);
+
+    static const QStringList settingsKeys();
+    static PaintRequest paintRequest(const QString &state); // PaintModeInvalid for unknown states
 
     void readSettings(const QSettings *settings);
+    void readSettings(const QVariantHash &settings);
+    // False, with errorMessage set, if any value is of the wrong type or out of range
+    static bool checkSettings(const QVariantHash &settings, QString &errorMessage);
     void writeSettings(QSettings *settings) const;
     bool loadInputImage(const QString &imageFileName, QString &errorMessage);
-    int savePoster(QIODevice *outputDevice) const;
+    // Loading on other threads: readPreviewImage() and loadInputImage() only touch
+    // the given loaders from createImageLoader(). setInputImage() takes one over.
+    ImageLoaderInterface *createImageLoader() const;
+    QImage readPreviewImage(const ImageLoaderInterface *imageLoader, const QString &imageFileName) const;
+    bool loadInputImage(ImageLoaderInterface *imageLoader, const QString &imageFileName, QString &errorMessage,
+                        QImage &previewImage, const std::atomic<bool> &canceled) const;
+    void setInputImage(ImageLoaderInterface *imageLoader, const QImage &previewImage);
+    void setLoadingPreviewImage(const QImage &previewImage); // Shown until setInputImage(). Null if loading failed
+    int savePoster(QIODevice *outputDevice, const Types::SavingProgressHandler &progressHandler = Types::SavingProgressHandler()) const;
+    // Writes each page into an image file of its own, rendered at dpi. The files are
+    // named by posterPageFileName(). Fails without leaving any of them behind
+    int savePosterPages(const QString &baseFileName, Types::PageImageFormats format, qreal dpi,
+                        const Types::SavingProgressHandler &progressHandler = Types::SavingProgressHandler()) const;
+    static QString posterPageFileName(const QString &baseFileName, Types::PageImageFormats format, int page, int pagesCount);
 
     QSize inputImageSizePixels() const;
     qreal inputImageHorizontalDpi() const;
@@ -71,11 +121,17 @@ public:
     QSizeF posterSize(Types::PosterSizeModes mode) const;
     Types::PosterSizeModes posterSizeMode() const;
     Qt::Alignment posterAlignment() const;
+    const PosterLayout &posterLayout() const; // Up to date after each setter
     QString fileName() const;
     bool isImageLoaded() const;
     const QVector<QPair<QStringList, QString> > &imageFormats() const;
     const QString imageIOLibraryName() const;
     const QString imageIOLibraryAboutText() const;
+    int compressionLevel() const;
+    int compressionThreadsCount() const;
+    Types::PdfImageModes pdfImageMode() const;
+    Types::PngPredictors pngPredictor() const;
+    Types::DeflateBackends deflateBackend() const;
 
     void setUnitOfLength(Types::UnitsOfLength unit);
     void setPaperFormat(const QString &format);
@@ -94,7 +150,16 @@ public:
     void setPosterHeight(Types::PosterSizeModes mode, qreal height);
     void setPosterSizeMode(Types::PosterSizeModes mode);
     void setPosterAlignment(Qt::Alignment alignment);
+    void setCompressionLevel(int level);
+    void setCompressionThreadsCount(int count);
+    void setPdfImageMode(Types::PdfImageModes mode);
+    void setPngPredictor(Types::PngPredictors predictor);
+    void setDeflateBackend(Types::DeflateBackends backend); // Unavailable ones fall back to zlib
+    void setPreviewImageEnabled(bool enabled); // Headless users need no preview
+    // Shows the quick preview at once, and a detailed one for large and high
+    // DPI windows when it is ready
     void createPreviewImage();
+    void paintOnCanvas(PaintCanvasInterface *paintCanvas, const PaintRequest &request) const;
 
 public slots:
     void paintOnCanvas(PaintCanvasInterface *paintCanvas, const QVariant &options) const;
@@ -105,6 +170,9 @@ private:
     qreal convertCmToDistance(qreal cm) const;
     QSizeF convertCmToSize(const QSizeF &sizeInCm) const;
     void createPreviewImage(const QSize &boxSize) const;
+    void createDetailedPreviewImage();
+    void waitForDetailedPreviewImages();
+    static QImage previewImage(const ImageLoaderInterface *imageLoader, const QSize &boxSize);
     qreal maximalVerticalPaperBorder() const;
     qreal maximalHorizontalPaperBorder() const;
     qreal convertBetweenAbsoluteAndPagesPosterDimension(qreal dimension, bool pagesToAbsolute, bool width) const;
@@ -113,26 +181,30 @@ private:
     qreal maximalOverLappingWidth() const;
     qreal maximalOverLappingHeight() const;
     qreal posterDimension(Types::PosterSizeModes mode, bool width) const;
-    QSizeF previewSize(const QSizeF &imageSize, const QSize &boxSize, bool enlargeToFit) const;
-    QSizeF inputImagePreviewSize(const QSize &boxSize) const;
+    static QSizeF previewSize(const QSizeF &imageSize, const QSize &boxSize, bool enlargeToFit);
     void paintImageOnCanvas(PaintCanvasInterface *paintCanvas) const;
     void paintPaperOnCanvas(PaintCanvasInterface *paintCanvas, bool paintOverlapping) const;
     void paintPosterOnCanvasOverlapped(PaintCanvasInterface *paintCanvas) const;
     void paintPosterOnCanvasDivided(PaintCanvasInterface *paintCanvas) const;
     void paintPosterOnCanvasPageWise(PaintCanvasInterface *paintCanvas, int page) const;
     void paintPosterPageOnCanvas(PaintCanvasInterface *paintCanvas, int page) const;
+    void updatePosterLayout();
 
 signals:
     void previewImageChanged(const QImage &image) const;
 
 private:
     ImageLoaderInterface* m_imageLoader = nullptr;
+    std::shared_ptr<ImageLoaderInterface> m_ownedImageLoader; // The one from setInputImage(). Shared with the preview thread
+    QVector<QFuture<QImage> > m_detailedPreviewImages; // The ones which may still run
+    int m_previewImageGeneration = 0; // Detailed previews of older generations are dropped
+    QSize m_loadingPreviewImageSize;
     Types::PosterSizeModes m_posterSizeMode = Types::PosterSizeModePages;
     qreal m_posterDimension = 2.0;
     bool m_posterDimensionIsWidth = true;
     Qt::Alignment m_posterAlignment = Qt::AlignCenter;
     bool m_usesCustomPaperSize = false;
-    QString m_paperFormat;
+    Types::PaperFormats m_paperFormat = Types::PaperFormatDinA4;
     QPageLayout::Orientation m_paperOrientation = QPageLayout::Portrait;
     qreal m_paperBorderTop = 1.5;
     qreal m_paperBorderRight = 1.5;
@@ -144,4 +216,11 @@ private:
     qreal m_overlappingHeight = 1.0;
     Qt::Alignment m_overlappingPosition = Qt::AlignBottom | Qt::AlignRight;
     Types::UnitsOfLength m_unitOfLength = Types::UnitOfLengthCentimeter;
+    int m_compressionLevel = 9;
+    int m_compressionThreadsCount = 0; // 0 means one thread per core
+    Types::PdfImageModes m_pdfImageMode = Types::PdfImageModeShared;
+    Types::PngPredictors m_pngPredictor = Types::PngPredictorNone;
+    Types::DeflateBackends m_deflateBackend = Types::DeflateBackendZlib;
+    bool m_previewImageEnabled = true;
+    PosterLayout m_posterLayout;
 };
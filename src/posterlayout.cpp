@@ -0,0 +1,152 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "posterlayout.h"
+
+#include <cmath>
+
+PosterLayout::PosterLayout(const QSize &imageSizePixels, const QSizeF &imageSizeCm, const QSizeF &posterSizePages,
+                           const QSizeF &printablePaperAreaSizeCm, const QSizeF &overlappingSizeCm,
+                           const QMarginsF &paperBordersCm, Qt::Alignment alignment)
+    : m_imageSizePixels(imageSizePixels)
+    , m_imageSizeCm(imageSizeCm)
+    , m_printablePaperAreaSizeCm(printablePaperAreaSizeCm)
+    , m_overlappingSizeCm(overlappingSizeCm)
+    , m_paperBordersCm(paperBordersCm)
+    , m_columnsCount(qMax(0, (int)ceil(posterSizePages.width())))
+    , m_rowsCount(qMax(0, (int)ceil(posterSizePages.height())))
+{
+    const QSizeF printablePosterAreaSizeCm(
+        m_columnsCount * printablePaperAreaSizeCm.width() - (m_columnsCount - 1) * overlappingSizeCm.width(),
+        m_rowsCount * printablePaperAreaSizeCm.height() - (m_rowsCount - 1) * overlappingSizeCm.height()
+    );
+    m_posterSizeCm = QSizeF(
+        printablePosterAreaSizeCm.width() + paperBordersCm.left() + paperBordersCm.right(),
+        printablePosterAreaSizeCm.height() + paperBordersCm.top() + paperBordersCm.bottom()
+    );
+
+    // Centered images are centered on the whole poster, but stay within its printable area
+    const qreal imageOffsetXCm = (
+        (alignment & Qt::AlignRight) ? printablePosterAreaSizeCm.width() - imageSizeCm.width()
+        : (alignment & Qt::AlignHCenter) ? (m_posterSizeCm.width() - imageSizeCm.width()) / 2 - paperBordersCm.left()
+        : 0
+    );
+    const qreal imageOffsetYCm = (
+        (alignment & Qt::AlignBottom) ? printablePosterAreaSizeCm.height() - imageSizeCm.height()
+        : (alignment & Qt::AlignVCenter) ? (m_posterSizeCm.height() - imageSizeCm.height()) / 2 - paperBordersCm.top()
+        : 0
+    );
+    m_imageOffsetCm = QPointF(
+        qBound(.0, imageOffsetXCm, printablePosterAreaSizeCm.width() - imageSizeCm.width()),
+        qBound(.0, imageOffsetYCm, printablePosterAreaSizeCm.height() - imageSizeCm.height())
+    );
+
+    const int pagesCount = this->pagesCount();
+    const QRectF pageRectCm(QPointF(), printablePaperAreaSizeCm);
+    const QRect imageRectPixels(QPoint(), imageSizePixels);
+    const qreal pixelsPerCmX = imageSizeCm.width() > 0 ? imageSizePixels.width() / imageSizeCm.width() : 0;
+    const qreal pixelsPerCmY = imageSizeCm.height() > 0 ? imageSizePixels.height() / imageSizeCm.height() : 0;
+    m_pageSourceRectsPixels.reserve(pagesCount);
+    for (int page = 0; page < pagesCount; page++) {
+        const QRectF imageRectCm = pageImageRectCm(page);
+        const QRectF visibleRectCm = pageRectCm & imageRectCm;
+        if (visibleRectCm.isEmpty()) {
+            m_pageSourceRectsPixels.append(QRect());
+            continue;
+        }
+        const QRectF sourceRectCm = visibleRectCm.translated(-imageRectCm.topLeft());
+        // Pixels which are partly on the page belong to it
+        const QPoint topLeftPixels((int)floor(sourceRectCm.left() * pixelsPerCmX),
+                                   (int)floor(sourceRectCm.top() * pixelsPerCmY));
+        const QPoint bottomRightPixels((int)ceil(sourceRectCm.right() * pixelsPerCmX),
+                                       (int)ceil(sourceRectCm.bottom() * pixelsPerCmY));
+        m_pageSourceRectsPixels.append(QRect(topLeftPixels, bottomRightPixels - QPoint(1, 1)) & imageRectPixels);
+    }
+}
+
+int PosterLayout::columnsCount() const
+{
+    return m_columnsCount;
+}
+
+int PosterLayout::rowsCount() const
+{
+    return m_rowsCount;
+}
+
+int PosterLayout::pagesCount() const
+{
+    return m_columnsCount * m_rowsCount;
+}
+
+QSize PosterLayout::imageSizePixels() const
+{
+    return m_imageSizePixels;
+}
+
+QSizeF PosterLayout::imageSizeCm() const
+{
+    return m_imageSizeCm;
+}
+
+QSizeF PosterLayout::printablePaperAreaSizeCm() const
+{
+    return m_printablePaperAreaSizeCm;
+}
+
+QSizeF PosterLayout::overlappingSizeCm() const
+{
+    return m_overlappingSizeCm;
+}
+
+QMarginsF PosterLayout::paperBordersCm() const
+{
+    return m_paperBordersCm;
+}
+
+QSizeF PosterLayout::posterSizeCm() const
+{
+    return m_posterSizeCm;
+}
+
+QPointF PosterLayout::imageOffsetCm() const
+{
+    return m_imageOffsetCm;
+}
+
+QRectF PosterLayout::pageImageRectCm(int page) const
+{
+    if (m_columnsCount == 0)
+        return QRectF();
+    const int column = page % m_columnsCount;
+    const int row = page / m_columnsCount;
+    const QPointF pageOffsetCm(
+        column * (m_printablePaperAreaSizeCm.width() - m_overlappingSizeCm.width()),
+        row * (m_printablePaperAreaSizeCm.height() - m_overlappingSizeCm.height())
+    );
+    return QRectF(m_imageOffsetCm - pageOffsetCm, m_imageSizeCm);
+}
+
+QRect PosterLayout::pageSourceRectPixels(int page) const
+{
+    return m_pageSourceRectsPixels.value(page);
+}
@@ -0,0 +1,70 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include <QMarginsF>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+// Where the image lies on the pages of a poster, and which part of it each
+// page shows. All lengths are in cm. PosteRazorCore computes it once after
+// each change of the settings or of the image. The previews, the saving and
+// the command line then only look it up.
+class PosterLayout
+{
+public:
+    PosterLayout() = default;
+    PosterLayout(const QSize &imageSizePixels, const QSizeF &imageSizeCm, const QSizeF &posterSizePages,
+                 const QSizeF &printablePaperAreaSizeCm, const QSizeF &overlappingSizeCm,
+                 const QMarginsF &paperBordersCm, Qt::Alignment alignment);
+
+    int columnsCount() const;
+    int rowsCount() const;
+    int pagesCount() const;
+    QSize imageSizePixels() const;
+    QSizeF imageSizeCm() const; // The image as large as on the poster
+    QSizeF printablePaperAreaSizeCm() const;
+    QSizeF overlappingSizeCm() const;
+    QMarginsF paperBordersCm() const;
+    QSizeF posterSizeCm() const; // All pages overlapped, with the outer paper borders
+    QPointF imageOffsetCm() const; // From the top left of the printable poster area
+
+    // The whole image, relative to the printable area of the page
+    QRectF pageImageRectCm(int page) const;
+    // The pixels of the image which are at least partly on the page. Empty
+    // for pages which show nothing of it
+    QRect pageSourceRectPixels(int page) const;
+
+private:
+    QSize m_imageSizePixels;
+    QSizeF m_imageSizeCm;
+    QSizeF m_printablePaperAreaSizeCm;
+    QSizeF m_overlappingSizeCm;
+    QMarginsF m_paperBordersCm;
+    QSizeF m_posterSizeCm;
+    QPointF m_imageOffsetCm;
+    int m_columnsCount = 0;
+    int m_rowsCount = 0;
+    QVector<QRect> m_pageSourceRectsPixels;
+};
@@ -0,0 +1,563 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "tiledimage.h"
+#include "pixelkernels.h"
+
+#include <QFile>
+
+#include <climits>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+
+#ifdef LIBJPEG_LIB
+#include <jpeglib.h>
+#endif
+#ifdef LIBPNG_LIB
+#include <png.h>
+#endif
+#ifdef LIBTIFF_LIB
+#include <tiffio.h>
+#endif
+
+// The rows are decoded, written and read back in bands of about this size
+const qint64 bandBytes = 16 * 1024 * 1024;
+
+static int bandRowsCount(int bytesPerLine)
+{
+    return int(qMax(qint64(1), bandBytes / bytesPerLine));
+}
+
+enum FileFormat {
+    FileFormatUnknown,
+    FileFormatJpeg,
+    FileFormatPng,
+    FileFormatTiff
+};
+
+// From the signature in the first bytes, regardless of the file name extension
+static FileFormat fileFormat(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return FileFormatUnknown;
+    const QByteArray signature = file.read(4);
+    if (signature.startsWith("\xff\xd8\xff"))
+        return FileFormatJpeg;
+    if (signature == "\x89PNG")
+        return FileFormatPng;
+    if (signature == QByteArray("II*\0", 4) || signature == QByteArray("MM\0*", 4))
+        return FileFormatTiff;
+    return FileFormatUnknown;
+}
+
+// Prepares store and header for rows of format
+static bool createImage(const QSize &sizePixels, QImage::Format format, TiledImageStore &store, QImage &header)
+{
+    header = QImage(1, 1, format);
+    const qint64 bytesPerLine = (qint64(sizePixels.width()) * header.depth() + 31) / 32 * 4;
+    if (header.isNull() || bytesPerLine > INT_MAX)
+        return false;
+    if (format == QImage::Format_Indexed8) {
+        QVector<QRgb> grayscaleColorTable(256);
+        for (int i = 0; i < grayscaleColorTable.count(); i++)
+            grayscaleColorTable[i] = qRgb(i, i, i);
+        header.setColorTable(grayscaleColorTable);
+    }
+    return store.create(sizePixels, int(bytesPerLine));
+}
+
+static void setResolution(QImage &header, qreal horizontalDots, qreal verticalDots, qreal metersPerUnit)
+{
+    if (horizontalDots > 0 && verticalDots > 0) {
+        header.setDotsPerMeterX(qRound(horizontalDots / metersPerUnit));
+        header.setDotsPerMeterY(qRound(verticalDots / metersPerUnit));
+    }
+}
+
+#ifdef LIBJPEG_LIB
+#if defined(JCS_EXTENSIONS) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+// libjpeg-turbo writes the bytes of Format_RGB32 rows itself
+const J_COLOR_SPACE jpegRgbColorSpace = JCS_EXT_BGRX;
+#else
+const J_COLOR_SPACE jpegRgbColorSpace = JCS_RGB;
+#endif
+
+struct JpegErrorManager
+{
+    jpeg_error_mgr manager; // First, so that libjpeg's pointer to it also points to this
+    jmp_buf jump;
+};
+
+static void jpegErrorExit(j_common_ptr info)
+{
+    longjmp(reinterpret_cast<JpegErrorManager*>(info->err)->jump, 1);
+}
+
+static void jpegOutputMessage(j_common_ptr info)
+{
+    // Warnings about recoverable damage are not shown
+    Q_UNUSED(info)
+}
+
+static bool loadJpeg(const QString &fileName, TiledImageStore &store, QImage &header)
+{
+    FILE *file = fopen(QFile::encodeName(fileName).constData(), "rb");
+    if (!file)
+        return false;
+
+    jpeg_decompress_struct info;
+    JpegErrorManager error;
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = jpegErrorExit;
+    error.manager.output_message = jpegOutputMessage;
+    // Declared before setjmp(), so that a longjmp() skips no destructor
+    QByteArray band;
+    QByteArray sourceRow;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        fclose(file);
+        return false;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+    const bool isGrayscale = info.jpeg_color_space == JCS_GRAYSCALE;
+    const bool isCmyk = info.jpeg_color_space == JCS_CMYK || info.jpeg_color_space == JCS_YCCK;
+    if (!isGrayscale)
+        info.out_color_space = isCmyk ? JCS_CMYK : jpegRgbColorSpace;
+    jpeg_start_decompress(&info);
+
+    const QSize sizePixels(int(info.output_width), int(info.output_height));
+    bool result = createImage(sizePixels, isGrayscale ? QImage::Format_Indexed8 : QImage::Format_RGB32, store, header);
+    if (info.density_unit == 1 || info.density_unit == 2)
+        setResolution(header, info.X_density, info.Y_density, info.density_unit == 1 ? .0254 : .01);
+
+    // Grayscale and libjpeg-turbo's RGB rows are decoded into the band, the others converted
+    const bool convertsRows = isCmyk || (!isGrayscale && jpegRgbColorSpace == JCS_RGB);
+    const int width = sizePixels.width();
+    const int rowsPerBand = result ? bandRowsCount(store.bytesPerLine()) : 0;
+    if (convertsRows)
+        sourceRow.resize(width * info.output_components);
+    for (int firstRow = 0; result && firstRow < sizePixels.height(); firstRow += rowsPerBand) {
+        const int rowsCount = qMin(rowsPerBand, sizePixels.height() - firstRow);
+        band.resize(rowsCount * store.bytesPerLine());
+        for (int row = 0; row < rowsCount; row++) {
+            uchar *line = reinterpret_cast<uchar*>(band.data()) + row * store.bytesPerLine();
+            JSAMPROW scanline = convertsRows ? reinterpret_cast<JSAMPROW>(sourceRow.data()) : line;
+            jpeg_read_scanlines(&info, &scanline, 1);
+            if (isCmyk) {
+                PixelKernels::cmykToRgb(scanline, reinterpret_cast<QRgb*>(line), width, info.saw_Adobe_marker);
+            } else if (convertsRows) {
+                QRgb *rgbLine = reinterpret_cast<QRgb*>(line);
+                for (int x = 0; x < width; x++, scanline += 3)
+                    rgbLine[x] = qRgb(scanline[0], scanline[1], scanline[2]);
+            }
+        }
+        result = store.writeRows(firstRow, rowsCount, band.constData());
+    }
+
+    jpeg_destroy_decompress(&info);
+    fclose(file);
+    return result;
+}
+#endif // LIBJPEG_LIB
+
+#ifdef LIBPNG_LIB
+static void pngError(png_structp png, png_const_charp message)
+{
+    Q_UNUSED(message)
+    png_longjmp(png, 1);
+}
+
+static void pngWarning(png_structp png, png_const_charp message)
+{
+    // Like the ones of libjpeg, warnings are not shown
+    Q_UNUSED(png)
+    Q_UNUSED(message)
+}
+
+static bool loadPng(const QString &fileName, TiledImageStore &store, QImage &header)
+{
+    FILE *file = fopen(QFile::encodeName(fileName).constData(), "rb");
+    if (!file)
+        return false;
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, pngError, pngWarning);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!info) {
+        png_destroy_read_struct(&png, nullptr, nullptr);
+        fclose(file);
+        return false;
+    }
+    // Declared before setjmp(), so that a longjmp() skips no destructor
+    QByteArray band;
+    QVector<QRgb> colorTable;
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        fclose(file);
+        return false;
+    }
+
+    png_init_io(png, file);
+    png_read_info(png, info);
+    const int colorType = png_get_color_type(png, info);
+    const bool hasTransparency = png_get_valid(png, info, PNG_INFO_tRNS) != 0;
+    // Grayscale and palette images stay 8 bit indexed, the others become 32 bit
+    QImage::Format format = QImage::Format_Indexed8;
+    png_set_strip_16(png);
+    png_set_packing(png);
+    if (colorType == PNG_COLOR_TYPE_GRAY && !hasTransparency) {
+        png_set_expand_gray_1_2_4_to_8(png);
+    } else if (colorType == PNG_COLOR_TYPE_PALETTE && !hasTransparency) {
+        png_colorp palette = nullptr;
+        int colorsCount = 0;
+        png_get_PLTE(png, info, &palette, &colorsCount);
+        colorTable.resize(colorsCount);
+        for (int i = 0; i < colorsCount; i++)
+            colorTable[i] = qRgb(palette[i].red, palette[i].green, palette[i].blue);
+    } else {
+        const bool hasAlphaChannel = hasTransparency || (colorType & PNG_COLOR_MASK_ALPHA);
+        format = hasAlphaChannel ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+        png_set_expand(png);
+        png_set_gray_to_rgb(png);
+        // The byte order of QRgbs in memory
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        png_set_bgr(png);
+        if (!hasAlphaChannel)
+            png_set_filler(png, 0xff, PNG_FILLER_AFTER);
+#else
+        if (hasAlphaChannel)
+            png_set_swap_alpha(png);
+        else
+            png_set_filler(png, 0xff, PNG_FILLER_BEFORE);
+#endif
+    }
+    png_read_update_info(png, info);
+
+    const QSize sizePixels(int(png_get_image_width(png, info)), int(png_get_image_height(png, info)));
+    // Interlaced rows are only complete after the last pass over the whole image
+    bool result = png_get_interlace_type(png, info) == PNG_INTERLACE_NONE
+        && createImage(sizePixels, format, store, header);
+    if (!colorTable.isEmpty())
+        header.setColorTable(colorTable);
+    png_uint_32 horizontalDots = 0;
+    png_uint_32 verticalDots = 0;
+    int unit = PNG_RESOLUTION_UNKNOWN;
+    if (png_get_pHYs(png, info, &horizontalDots, &verticalDots, &unit) && unit == PNG_RESOLUTION_METER)
+        setResolution(header, horizontalDots, verticalDots, 1);
+
+    const int rowsPerBand = result ? bandRowsCount(store.bytesPerLine()) : 0;
+    for (int firstRow = 0; result && firstRow < sizePixels.height(); firstRow += rowsPerBand) {
+        const int rowsCount = qMin(rowsPerBand, sizePixels.height() - firstRow);
+        band.resize(rowsCount * store.bytesPerLine());
+        for (int row = 0; row < rowsCount; row++)
+            png_read_row(png, reinterpret_cast<png_bytep>(band.data()) + row * store.bytesPerLine(), nullptr);
+        result = store.writeRows(firstRow, rowsCount, band.constData());
+    }
+
+    png_destroy_read_struct(&png, &info, nullptr);
+    fclose(file);
+    return result;
+}
+#endif // LIBPNG_LIB
+
+#ifdef LIBTIFF_LIB
+static bool loadTiff(const QString &fileName, TiledImageStore &store, QImage &header)
+{
+    TIFF *tiff = TIFFOpen(QFile::encodeName(fileName).constData(), "r");
+    if (!tiff)
+        return false;
+
+    // TIFFRGBAImage converts all photometric interpretations and bit depths
+    char message[1024];
+    TIFFRGBAImage image;
+    if (!TIFFRGBAImageOK(tiff, message) || !TIFFRGBAImageBegin(&image, tiff, 0, message)) {
+        TIFFClose(tiff);
+        return false;
+    }
+    image.req_orientation = ORIENTATION_TOPLEFT;
+
+    const QSize sizePixels(int(image.width), int(image.height));
+    bool result = createImage(sizePixels, image.alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32, store, header);
+    float horizontalResolution = 0;
+    float verticalResolution = 0;
+    uint16_t unit = RESUNIT_INCH;
+    if (TIFFGetField(tiff, TIFFTAG_XRESOLUTION, &horizontalResolution)
+        && TIFFGetField(tiff, TIFFTAG_YRESOLUTION, &verticalResolution)) {
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_RESOLUTIONUNIT, &unit);
+        if (unit == RESUNIT_INCH || unit == RESUNIT_CENTIMETER)
+            setResolution(header, horizontalResolution, verticalResolution, unit == RESUNIT_INCH ? .0254 : .01);
+    }
+
+    // The bands hold whole strips or rows of tiles, because libtiff decodes a
+    // strip from its start for every band which begins inside of it. Images
+    // with strips beyond the resident limit would be decoded quadratically, or
+    // need such a large band, so they are left to the whole image loaders.
+    uint32_t blockRowsCount = 0;
+    if (TIFFIsTiled(tiff))
+        TIFFGetField(tiff, TIFFTAG_TILELENGTH, &blockRowsCount);
+    else
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &blockRowsCount);
+    blockRowsCount = qMin(blockRowsCount, uint32_t(sizePixels.height()));
+    result = result && blockRowsCount > 0
+        && qint64(blockRowsCount) * store.bytesPerLine() <= TiledImageStore::defaultResidentBytesLimit;
+    const int rowsPerBand = result ? qMax(1, bandRowsCount(store.bytesPerLine()) / int(blockRowsCount)) * int(blockRowsCount) : 0;
+
+    QByteArray band;
+    const bool isPremultiplied = image.alpha == EXTRASAMPLE_ASSOCALPHA;
+    for (int firstRow = 0; result && firstRow < sizePixels.height(); firstRow += rowsPerBand) {
+        const int rowsCount = qMin(rowsPerBand, sizePixels.height() - firstRow);
+        band.resize(rowsCount * store.bytesPerLine());
+        // A B G R in the packed 32 bit values, turned into QRgbs in place
+        uint32_t *raster = reinterpret_cast<uint32_t*>(band.data());
+        image.row_offset = firstRow;
+        image.col_offset = 0;
+        result = TIFFRGBAImageGet(&image, raster, uint32_t(sizePixels.width()), uint32_t(rowsCount)) != 0;
+        for (qint64 i = 0; result && i < qint64(rowsCount) * sizePixels.width(); i++) {
+            const QRgb pixel = qRgba(int(TIFFGetR(raster[i])), int(TIFFGetG(raster[i])),
+                                     int(TIFFGetB(raster[i])), int(TIFFGetA(raster[i])));
+            raster[i] = isPremultiplied ? qUnpremultiply(pixel) : pixel;
+        }
+        result = result && store.writeRows(firstRow, rowsCount, band.constData());
+    }
+
+    TIFFRGBAImageEnd(&image);
+    TIFFClose(tiff);
+    return result;
+}
+#endif // LIBTIFF_LIB
+
+bool TiledImage::canLoad(const QString &fileName)
+{
+    const FileFormat format = fileFormat(fileName);
+    Q_UNUSED(format)
+#ifdef LIBJPEG_LIB
+    if (format == FileFormatJpeg)
+        return true;
+#endif
+#ifdef LIBPNG_LIB
+    if (format == FileFormatPng)
+        return true;
+#endif
+#ifdef LIBTIFF_LIB
+    if (format == FileFormatTiff)
+        return true;
+#endif
+    return false;
+}
+
+qint64 TiledImage::residentBytesCount()
+{
+    // The mapped tiles, and one band which is being decoded or read
+    return TiledImageStore::defaultResidentBytesLimit + bandBytes;
+}
+
+bool TiledImage::load(const QString &fileName)
+{
+    close();
+    const FileFormat format = fileFormat(fileName);
+    Q_UNUSED(format)
+    bool result = false;
+#ifdef LIBJPEG_LIB
+    if (format == FileFormatJpeg)
+        result = loadJpeg(fileName, m_store, m_header);
+#endif
+#ifdef LIBPNG_LIB
+    if (format == FileFormatPng)
+        result = loadPng(fileName, m_store, m_header);
+#endif
+#ifdef LIBTIFF_LIB
+    if (format == FileFormatTiff)
+        result = loadTiff(fileName, m_store, m_header);
+#endif
+    if (!result)
+        close();
+    return result;
+}
+
+void TiledImage::close()
+{
+    m_store.close();
+    m_header = QImage();
+}
+
+bool TiledImage::isOpen() const
+{
+    return m_store.isOpen();
+}
+
+QSize TiledImage::sizePixels() const
+{
+    return m_store.sizePixels();
+}
+
+const QImage &TiledImage::header() const
+{
+    return m_header;
+}
+
+Types::ColorTypes TiledImage::colorDataType() const
+{
+    switch (m_header.format()) {
+    case QImage::Format_Indexed8:
+        return m_header.isGrayscale() ? Types::ColorTypeGreyscale : Types::ColorTypePalette;
+    case QImage::Format_ARGB32:
+        return Types::ColorTypeRGBA;
+    default:
+        return Types::ColorTypeRGB;
+    }
+}
+
+int TiledImage::bitsPerPixel() const
+{
+    return colorDataType() == Types::ColorTypeRGB ? 24 : m_header.depth();
+}
+
+void TiledImage::readScanlines(int firstScanline, int scanlinesCount, char *destination) const
+{
+    const int width = sizePixels().width();
+    const int bitsPerPixel = this->bitsPerPixel();
+    const int bytesPerLine = (width * bitsPerPixel + 7) / 8;
+    const int rowsPerBand = bandRowsCount(m_store.bytesPerLine());
+
+    QByteArray band;
+    for (int firstRow = firstScanline; firstRow < firstScanline + scanlinesCount; firstRow += rowsPerBand) {
+        const int rowsCount = qMin(rowsPerBand, firstScanline + scanlinesCount - firstRow);
+        band.resize(rowsCount * m_store.bytesPerLine());
+        m_store.readRows(firstRow, rowsCount, band.data());
+        for (int row = 0; row < rowsCount; row++) {
+            const uchar *line = reinterpret_cast<const uchar*>(band.constData()) + row * m_store.bytesPerLine();
+            uchar *target = reinterpret_cast<uchar*>(destination);
+            if (bitsPerPixel == 8) {
+                memcpy(target, line, size_t(bytesPerLine));
+            } else {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+                if (bitsPerPixel == 24)
+                    PixelKernels::bgraToRgb(line, target, width);
+                else
+                    PixelKernels::bgraToArgb(line, target, width);
+#else
+                // The rows hold A R G B bytes already
+                if (bitsPerPixel == 24)
+                    for (int x = 0; x < width; x++)
+                        memcpy(target + x * 3, line + x * 4 + 1, 3);
+                else
+                    memcpy(target, line, size_t(bytesPerLine));
+#endif
+            }
+            destination += bytesPerLine;
+        }
+    }
+}
+
+// Adds weight times the premultiplied pixels of line to sum, channel by channel
+static void addWeightedRow(float *sum, const QRgb *line, int width, float weight)
+{
+    for (int x = 0; x < width; x++) {
+        *sum++ += qAlpha(line[x]) * weight;
+        *sum++ += qRed(line[x]) * weight;
+        *sum++ += qGreen(line[x]) * weight;
+        *sum++ += qBlue(line[x]) * weight;
+    }
+}
+
+static void storeRow(QRgb *destination, const float *sum, int width)
+{
+    for (int x = 0; x < width; x++, sum += 4)
+        destination[x] = qRgba(qBound(0, int(sum[1] + .5f), 255), qBound(0, int(sum[2] + .5f), 255),
+                               qBound(0, int(sum[3] + .5f), 255), qBound(0, int(sum[0] + .5f), 255));
+}
+
+QImage TiledImage::imageAsRGB(const QRect &sourceRect, const QSize &size) const
+{
+    // Both share the memory layout, only the alpha channel has to be unpremultiplied in the end
+    const bool hasAlphaChannel = m_header.hasAlphaChannel();
+    QImage result(size, hasAlphaChannel ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    if (result.isNull() || sourceRect.isEmpty())
+        return result;
+
+    // The bands are only scaled horizontally, so that no filter ever sees their
+    // edges. The rows are then resampled vertically across the bands like
+    // QImage::scaled() does: averaged over the covered area when scaling down,
+    // interpolated between the two nearest rows when scaling up.
+    // Downscaling counts in units where a source row is size.height() long and
+    // a result row sourceRect.height(), so that all row edges are integers.
+    const int width = size.width();
+    const qint64 sourceRowLength = size.height();
+    const qint64 targetRowLength = sourceRect.height();
+    const bool scalesDown = targetRowLength >= sourceRowLength;
+    QVector<float> sum(width * 4, 0);
+    QImage previousLine;
+    int targetRow = 0;
+
+    const int rowsPerBand = bandRowsCount(m_store.bytesPerLine());
+    for (int firstRow = sourceRect.top(); firstRow <= sourceRect.bottom(); firstRow += rowsPerBand) {
+        const int rowsCount = qMin(rowsPerBand, sourceRect.bottom() + 1 - firstRow);
+        QImage band(m_store.sizePixels().width(), rowsCount, m_header.format());
+        band.setColorTable(m_header.colorTable());
+        m_store.readRows(firstRow, rowsCount, reinterpret_cast<char*>(band.bits()));
+        const QImage scaledBand = band.copy(sourceRect.left(), 0, sourceRect.width(), rowsCount)
+            .scaled(width, rowsCount, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+            .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+        for (int bandRow = 0; bandRow < rowsCount && targetRow < size.height(); bandRow++) {
+            const int row = firstRow - sourceRect.top() + bandRow;
+            const QRgb *line = reinterpret_cast<const QRgb*>(scaledBand.constScanLine(bandRow));
+            if (scalesDown) {
+                // The source row is spread over the one or two result rows which it overlaps
+                qint64 start = row * sourceRowLength;
+                const qint64 end = start + sourceRowLength;
+                while (start < end && targetRow < size.height()) {
+                    const qint64 targetRowEnd = (targetRow + 1) * targetRowLength;
+                    const qint64 overlapEnd = qMin(end, targetRowEnd);
+                    addWeightedRow(sum.data(), line, width, float(overlapEnd - start) / targetRowLength);
+                    start = overlapEnd;
+                    if (overlapEnd == targetRowEnd) {
+                        storeRow(reinterpret_cast<QRgb*>(result.scanLine(targetRow++)), sum.constData(), width);
+                        sum.fill(0);
+                    }
+                }
+            } else {
+                // The result rows whose centers lie up to this source row. Beyond
+                // the first and the last row, these are simply repeated
+                const bool isLastRow = row == sourceRect.height() - 1;
+                while (targetRow < size.height()) {
+                    const qreal center = (targetRow + .5) * targetRowLength / sourceRowLength - .5;
+                    if (center > row && !isLastRow)
+                        break;
+                    const float weight = previousLine.isNull() ? 1 : float(qBound(qreal(0), center - (row - 1), qreal(1)));
+                    sum.fill(0);
+                    if (weight < 1)
+                        addWeightedRow(sum.data(), reinterpret_cast<const QRgb*>(previousLine.constBits()), width, 1 - weight);
+                    addWeightedRow(sum.data(), line, width, weight);
+                    storeRow(reinterpret_cast<QRgb*>(result.scanLine(targetRow++)), sum.constData(), width);
+                }
+                previousLine = scaledBand.copy(0, bandRow, width, 1);
+            }
+        }
+    }
+
+    return hasAlphaChannel ? result.convertToFormat(QImage::Format_ARGB32) : result;
+}
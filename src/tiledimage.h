@@ -0,0 +1,64 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include "tiledimagestore.h"
+#include "types.h"
+
+#include <QImage>
+
+// An image which is too large for the memory, decoded in a single pass from
+// the top row to the bottom one into a TiledImageStore. The rows keep the
+// memory layout of a QImage in the format of header(): Format_Indexed8,
+// Format_RGB32 or Format_ARGB32. Only the formats of the decoding libraries
+// which were found at build time can be loaded.
+class TiledImage
+{
+public:
+    // Images which would take more memory than this are loaded tiled
+    static const qint64 minimumBytes = qint64(1024) * 1024 * 1024;
+
+    // Whether load() has a decoder for the format of the file
+    static bool canLoad(const QString &fileName);
+    // The memory which a loaded image keeps, including the buffers for loading it
+    static qint64 residentBytesCount();
+
+    bool load(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    QSize sizePixels() const;
+    // One pixel with the format, color table and resolution of the image
+    const QImage &header() const;
+    Types::ColorTypes colorDataType() const;
+    int bitsPerPixel() const;
+
+    // All of them may be called from several threads at once
+    // The rows like ImageLoaderInterface::readScanlines() writes them
+    void readScanlines(int firstScanline, int scanlinesCount, char *destination) const;
+    QImage imageAsRGB(const QRect &sourceRect, const QSize &size) const;
+
+private:
+    TiledImageStore m_store;
+    QImage m_header;
+};
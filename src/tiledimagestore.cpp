@@ -0,0 +1,172 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "tiledimagestore.h"
+
+#include <QDir>
+
+#include <cstring>
+
+// Few enough tiles for short bookkeeping, small enough that a page of the
+// poster only maps the rows it needs
+const qint64 tileBytes = 16 * 1024 * 1024;
+
+TiledImageStore::~TiledImageStore()
+{
+    close();
+}
+
+bool TiledImageStore::create(const QSize &sizePixels, int bytesPerLine)
+{
+    close();
+    if (sizePixels.isEmpty() || bytesPerLine <= 0)
+        return false;
+
+    m_file.reset(new QTemporaryFile(QDir(QDir::tempPath()).filePath(QLatin1String("posterazor-XXXXXX.tiles"))));
+    if (!m_file->open() || !m_file->resize(qint64(bytesPerLine) * sizePixels.height())) {
+        m_file.reset();
+        return false;
+    }
+
+    m_sizePixels = sizePixels;
+    m_bytesPerLine = bytesPerLine;
+    m_tileRowsCount = int(qBound(qint64(1), tileBytes / bytesPerLine, qint64(sizePixels.height())));
+    m_mappedTiles.fill(nullptr, (sizePixels.height() + m_tileRowsCount - 1) / m_tileRowsCount);
+    m_tilePinsCounts.fill(0, m_mappedTiles.count());
+    return true;
+}
+
+void TiledImageStore::close()
+{
+    QMutexLocker locker(&m_mutex);
+    for (uchar *tile : m_mappedTiles)
+        if (tile)
+            m_file->unmap(tile);
+    m_mappedTiles.clear();
+    m_tilePinsCounts.clear();
+    m_recentTiles.clear();
+    m_file.reset();
+    m_sizePixels = QSize();
+    m_bytesPerLine = 0;
+    m_tileRowsCount = 0;
+}
+
+bool TiledImageStore::isOpen() const
+{
+    return !m_file.isNull();
+}
+
+QSize TiledImageStore::sizePixels() const
+{
+    return m_sizePixels;
+}
+
+int TiledImageStore::bytesPerLine() const
+{
+    return m_bytesPerLine;
+}
+
+void TiledImageStore::setResidentBytesLimit(qint64 bytes)
+{
+    m_residentBytesLimit = qMax(tileBytes, bytes);
+}
+
+bool TiledImageStore::writeRows(int firstRow, int rowsCount, const char *source)
+{
+    return copyRows(firstRow, rowsCount, const_cast<char*>(source), true);
+}
+
+bool TiledImageStore::readRows(int firstRow, int rowsCount, char *destination) const
+{
+    return copyRows(firstRow, rowsCount, destination, false);
+}
+
+bool TiledImageStore::copyRows(int firstRow, int rowsCount, char *rows, bool toStore) const
+{
+    if (!isOpen() || firstRow < 0 || rowsCount < 0 || firstRow + rowsCount > m_sizePixels.height())
+        return false;
+
+    int row = firstRow;
+    while (row < firstRow + rowsCount) {
+        const int tile = row / m_tileRowsCount;
+        uchar *tileData = pinnedTile(tile);
+        if (!tileData)
+            return false;
+        const int tileFirstRow = tile * m_tileRowsCount;
+        const int count = qMin(firstRow + rowsCount, tileFirstRow + m_tileRowsCount) - row;
+        const qint64 bytesCount = qint64(count) * m_bytesPerLine;
+        uchar *tileRows = tileData + qint64(row - tileFirstRow) * m_bytesPerLine;
+        // Outside of the lock, so that the threads copy in parallel. Writers
+        // of the same rows are not expected.
+        if (toStore)
+            memcpy(tileRows, rows, size_t(bytesCount));
+        else
+            memcpy(rows, tileRows, size_t(bytesCount));
+        unpinTile(tile);
+        rows += bytesCount;
+        row += count;
+    }
+    return true;
+}
+
+uchar *TiledImageStore::pinnedTile(int tile) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (uchar *tileData = m_mappedTiles.at(tile)) {
+        m_recentTiles.removeOne(tile);
+        m_recentTiles.append(tile);
+        m_tilePinsCounts[tile]++;
+        return tileData;
+    }
+
+    // The unmapped tiles stay in the file, and the system may drop their
+    // pages. Pinned tiles are being copied and stay mapped, even if that
+    // exceeds the limit for a moment.
+    const qint64 bytesPerTile = qint64(m_tileRowsCount) * m_bytesPerLine;
+    for (int i = 0; i < m_recentTiles.count()
+         && (m_recentTiles.count() + 1) * bytesPerTile > m_residentBytesLimit; ) {
+        const int recentTile = m_recentTiles.at(i);
+        if (m_tilePinsCounts.at(recentTile) > 0) {
+            i++;
+            continue;
+        }
+        m_recentTiles.removeAt(i);
+        m_file->unmap(m_mappedTiles.at(recentTile));
+        m_mappedTiles[recentTile] = nullptr;
+    }
+
+    const int tileFirstRow = tile * m_tileRowsCount;
+    const int tileRowsCount = qMin(m_tileRowsCount, m_sizePixels.height() - tileFirstRow);
+    uchar *tileData = m_file->map(tileFirstRow * qint64(m_bytesPerLine), qint64(tileRowsCount) * m_bytesPerLine);
+    if (tileData) {
+        m_mappedTiles[tile] = tileData;
+        m_recentTiles.append(tile);
+        m_tilePinsCounts[tile]++;
+    }
+    return tileData;
+}
+
+void TiledImageStore::unpinTile(int tile) const
+{
+    QMutexLocker locker(&m_mutex);
+    m_tilePinsCounts[tile]--;
+}
@@ -0,0 +1,72 @@
+/*
+    PosteRazor - Make your own poster!
+    Copyright (C) 2005-2018 by Alessandro Portale
+    http://posterazor.sourceforge.net/
+
+    This file is part of PosteRazor
+
+    PosteRazor is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PosteRazor is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PosteRazor; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QScopedPointer>
+#include <QSize>
+#include <QTemporaryFile>
+#include <QVector>
+
+// The rows of an image in a temporary file, for images larger than the
+// memory. The file is divided into tiles of whole rows, because everything
+// which reads the image goes by scanlines. Tiles are mapped into memory when
+// they are accessed. The least recently used ones are unmapped again, once the
+// mapped tiles exceed the resident limit.
+class TiledImageStore
+{
+public:
+    static const qint64 defaultResidentBytesLimit = 256 * 1024 * 1024;
+
+    TiledImageStore() = default;
+    ~TiledImageStore();
+
+    bool create(const QSize &sizePixels, int bytesPerLine);
+    void close();
+    bool isOpen() const;
+    QSize sizePixels() const;
+    int bytesPerLine() const;
+    void setResidentBytesLimit(qint64 bytes);
+
+    // Both may be called from several threads at once
+    bool writeRows(int firstRow, int rowsCount, const char *source);
+    bool readRows(int firstRow, int rowsCount, char *destination) const;
+
+private:
+    Q_DISABLE_COPY(TiledImageStore)
+
+    bool copyRows(int firstRow, int rowsCount, char *rows, bool toStore) const;
+    // Maps the tile if needed and keeps it mapped until it is unpinned
+    uchar *pinnedTile(int tile) const;
+    void unpinTile(int tile) const;
+
+    QScopedPointer<QTemporaryFile> m_file; // Removed along with it
+    QSize m_sizePixels;
+    int m_bytesPerLine = 0;
+    int m_tileRowsCount = 0;
+    qint64 m_residentBytesLimit = defaultResidentBytesLimit;
+    mutable QMutex m_mutex; // Only for the bookkeeping, not for copying the rows
+    mutable QVector<uchar*> m_mappedTiles; // nullptr for the unmapped ones
+    mutable QVector<int> m_tilePinsCounts; // Copies in progress of each tile
+    mutable QVector<int> m_recentTiles; // Mapped tiles, the least recently used one first
+};
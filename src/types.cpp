@@ -26,31 +26,20 @@
 #include <QSizeF>
 #include <QtDebug>
 
+constexpr Types::UnitOfLength Types::unitOfLengthTable[];
+constexpr Types::PaperFormat Types::paperFormatTable[];
+
 const QHash<Types::UnitsOfLength, QPair<QString, qreal> > &Types::unitsOfLength()
 {
-    const static QHash<UnitsOfLength, QPair<QString, qreal> > units = {
-        {UnitOfLengthMeter,         {QLatin1String("m"),        100.00}},
-        {UnitOfLengthMillimeter,    {QLatin1String("mm"),         0.10}},
-        {UnitOfLengthCentimeter,    {QLatin1String("cm"),         1.00}},
-        {UnitOfLengthInch,          {QLatin1String("in"),         2.54}},
-        {UnitOfLengthFeet,          {QLatin1String("ft"), 2.54 * 12.00}},
-        {UnitOfLengthPoints,        {QLatin1String("pt"), 2.54 / 72.00}}
-    };
+    const static QHash<UnitsOfLength, QPair<QString, qreal> > units = [] {
+        QHash<UnitsOfLength, QPair<QString, qreal> > result;
+        for (int unit = 0; unit < UnitsOfLengthCount; unit++)
+            result.insert((UnitsOfLength)unit, {QLatin1String(unitOfLengthTable[unit].name), unitOfLengthTable[unit].centimeters});
+        return result;
+    }();
     return units;
 }
 
-qreal Types::convertBetweenUnitsOfLength(qreal distance, UnitsOfLength sourceUnit, UnitsOfLength targetUnit)
-{
-    qreal convertedDistance = distance;
-    if (sourceUnit != targetUnit) {
-        if (sourceUnit != UnitOfLengthCentimeter)
-            convertedDistance *= unitsOfLength().value(sourceUnit).second;
-        if (targetUnit != UnitOfLengthCentimeter)
-            convertedDistance /= unitsOfLength().value(targetUnit).second;
-    }
-    return convertedDistance;
-}
-
 QSizeF Types::convertBetweenUnitsOfLength(const QSizeF &size, UnitsOfLength sourceUnit, UnitsOfLength targetUnit)
 {
     return {
@@ -61,35 +50,46 @@ QSizeF Types::convertBetweenUnitsOfLength(const QSizeF &size, UnitsOfLength sour
 
 Types::UnitsOfLength Types::unitOfLenthFromString(const QString &string)
 {
-    static QHash<QString, UnitsOfLength> hash;
-    if (hash.isEmpty()) {
-        const QList<UnitsOfLength> units = unitsOfLength().keys();
-        foreach (UnitsOfLength unit, units)
-            hash.insert(unitsOfLength().value(unit).first, unit);
-    }
-    return hash.value(string);
+    for (int unit = 0; unit < UnitsOfLengthCount; unit++)
+        if (string == QLatin1String(unitOfLengthTable[unit].name))
+            return (UnitsOfLength)unit;
+    return UnitOfLengthMeter;
 }
 
 const QHash<QString, QSizeF> &Types::paperFormats()
 {
-    const static QHash<QString, QSizeF> formats =
-    {
-        {QLatin1String("DIN A4"),   {21.0, 29.7}},
-        {QLatin1String("DIN A3"),   {29.7, 42.0}},
-        {QLatin1String("Legal"),    {21.6, 35.6}},
-        {QLatin1String("Letter"),   {21.6, 27.9}},
-        {QLatin1String("Tabloid"),  {27.9, 43.2}},
-        {QLatin1String("A3+"),      {32.9, 48.3}}
-    };
+    const static QHash<QString, QSizeF> formats = [] {
+        QHash<QString, QSizeF> result;
+        for (const PaperFormat &format : paperFormatTable)
+            result.insert(QLatin1String(format.name), {format.widthCm, format.heightCm});
+        return result;
+    }();
     return formats;
 }
 
+Types::PaperFormats Types::paperFormatFromString(const QString &string)
+{
+    for (int format = 0; format < PaperFormatsCount; format++)
+        if (string == QLatin1String(paperFormatTable[format].name))
+            return (PaperFormats)format;
+    return PaperFormatsCount;
+}
+
+QSizeF Types::paperSize(PaperFormats format, QPageLayout::Orientation orientation, UnitsOfLength unit)
+{
+    if (format == PaperFormatsCount)
+        return QSizeF();
+    const PaperFormat &paperFormat = paperFormatTable[format];
+    const bool isLandscape = orientation == QPageLayout::Landscape;
+    return {
+        convertBetweenUnitsOfLength(isLandscape ? paperFormat.heightCm : paperFormat.widthCm, UnitOfLengthCentimeter, unit),
+        convertBetweenUnitsOfLength(isLandscape ? paperFormat.widthCm : paperFormat.heightCm, UnitOfLengthCentimeter, unit)
+    };
+}
+
 QSizeF Types::paperSize(const QString &format, QPageLayout::Orientation orientation, UnitsOfLength unit)
 {
-    QSizeF result = paperFormats().value(format);
-    if (orientation == QPageLayout::Landscape)
-        result.transpose();
-    return convertBetweenUnitsOfLength(result, UnitOfLengthCentimeter, unit);
+    return paperSize(paperFormatFromString(format), orientation, unit);
 }
 
 QString Types::cleanString(const QString &dirtyString)
@@ -25,6 +25,8 @@
 #include <QPair>
 #include <QPageLayout>
 
+#include <functional>
+
 class Types
 {
 public:
@@ -44,20 +46,106 @@ public:
         ColorTypeCMYK
     };
 
+    enum PdfImageModes {
+        PdfImageModeShared,     // One image, clipped on every page. Smallest file
+        PdfImageModePerPage,    // Each page gets a crop of the image. Fastest to print
+        PdfImageModeTiled       // One grid of image tiles, pages use the ones they show
+    };
+
+    enum PngPredictors {
+        PngPredictorNone,       // Raw samples
+        PngPredictorSub,        // Difference to the left pixel
+        PngPredictorUp,         // Difference to the pixel above
+        PngPredictorPaeth,      // Difference to the closest of left, above and above left
+        PngPredictorAdaptive    // The one of the above which suits each row best
+    };
+
+    enum DeflateBackends {
+        DeflateBackendZlib,     // Always available, the fallback for the others
+        DeflateBackendZlibNg,   // Faster streaming, if built with ZLIBNG_LIB
+        DeflateBackendLibDeflate // Fastest for image tiles, if built with LIBDEFLATE_LIB
+    };
+
+    enum SavingStages {
+        SavingStageImage,       // Rows read from the image
+        SavingStageCompression, // Bytes of image data compressed or copied
+        SavingStagePages        // Pages written
+    };
+
+    // Called by the saving thread. Returning false cancels the saving, which
+    // then fails with savingCanceledError.
+    typedef std::function<bool(SavingStages stage, qint64 done, qint64 total)> SavingProgressHandler;
+    static const int savingCanceledError = 5;
+    static const int savingPageImageError = 6; // A page image could not be rendered or written
+
+    enum PageImageFormats {
+        PageImageFormatPng,
+        PageImageFormatTiff
+    };
+
     enum UnitsOfLength {
         UnitOfLengthMeter,
         UnitOfLengthMillimeter,
         UnitOfLengthCentimeter,
         UnitOfLengthInch,
         UnitOfLengthFeet,
-        UnitOfLengthPoints
+        UnitOfLengthPoints,
+        UnitsOfLengthCount
     };
 
-    static const QHash<UnitsOfLength, QPair<QString, qreal> > &unitsOfLength();
-    static qreal convertBetweenUnitsOfLength(qreal distance, UnitsOfLength sourceUnit, UnitsOfLength targetUnit);
+    enum PaperFormats {
+        PaperFormatDinA4,
+        PaperFormatDinA3,
+        PaperFormatLegal,
+        PaperFormatLetter,
+        PaperFormatTabloid,
+        PaperFormatA3Plus,
+        PaperFormatsCount       // Also returned for unknown names
+    };
+
+    struct UnitOfLength {
+        const char *name;
+        qreal centimeters;
+    };
+
+    struct PaperFormat {
+        const char *name;
+        qreal widthCm;
+        qreal heightCm;
+    };
+
+    // Indexed by the enums. The layout code converts lengths all the time,
+    // so these need no lookup by name
+    static constexpr UnitOfLength unitOfLengthTable[UnitsOfLengthCount] = {
+        {"m",   100.00},
+        {"mm",    0.10},
+        {"cm",    1.00},
+        {"in",    2.54},
+        {"ft",    2.54 * 12.00},
+        {"pt",    2.54 / 72.00}
+    };
+    static constexpr PaperFormat paperFormatTable[PaperFormatsCount] = {
+        {"DIN A4",  21.0, 29.7},
+        {"DIN A3",  29.7, 42.0},
+        {"Legal",   21.6, 35.6},
+        {"Letter",  21.6, 27.9},
+        {"Tabloid", 27.9, 43.2},
+        {"A3+",     32.9, 48.3}
+    };
+
+    static constexpr qreal convertBetweenUnitsOfLength(qreal distance, UnitsOfLength sourceUnit, UnitsOfLength targetUnit)
+    {
+        return sourceUnit == targetUnit ? distance
+            : distance * unitOfLengthTable[sourceUnit].centimeters / unitOfLengthTable[targetUnit].centimeters;
+    }
     static QSizeF convertBetweenUnitsOfLength(const QSizeF &size, UnitsOfLength sourceUnit, UnitsOfLength targetUnit);
+    static QSizeF paperSize(PaperFormats format, QPageLayout::Orientation orientation, UnitsOfLength unit);
+
+    // Wrappers with names, for the user interface and the settings
+    static const QHash<UnitsOfLength, QPair<QString, qreal> > &unitsOfLength();
     static UnitsOfLength unitOfLenthFromString(const QString &string);
     static const QHash<QString, QSizeF> &paperFormats();
+    static PaperFormats paperFormatFromString(const QString &string);
     static QSizeF paperSize(const QString &format, QPageLayout::Orientation orientation, UnitsOfLength unit);
 
     // These two functions help to format help text. I know, they do not belong, here.
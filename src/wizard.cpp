@@ -288,7 +288,7 @@ void Wizard::setLaunchPDFApplication(bool launch)
 
 void Wizard::updatePreview()
 {
-    m_paintCanvas->repaint();
+    m_paintCanvas->scheduleUpdate();
 }
 
 void Wizard::showImageFileName(const QString &fileName)